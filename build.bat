@@ -1,6 +1,11 @@
 mkdir bin 2> nul
 
-gcc -o bin\single_player src\single_player.c
+gcc -o bin\chess_gen src\chess_gen.c
+bin\chess_gen > src\chess_tables.h
+
+gcc -O2 -o bin\single_player src\single_player.c
 gcc -o bin\server src\server.c -lws2_32
 gcc -o bin\client src\client.c -lws2_32
-gcc -o bin\single_player_ui src\single_player_ui.c -lgdi32 -lopengl32
+gcc -O2 -o bin\single_player_ui src\single_player_ui.c -lgdi32 -lopengl32
+gcc -O2 -o bin\perft src\perft.c
+gcc -O2 -o bin\bench src\bench.c
@@ -2,8 +2,17 @@
 
 mkdir bin 2> /dev/null
 
-gcc -I../js-c -o bin/single_player src/single_player.c
-gcc -I../js-c -o bin/server src/server.c
-gcc -I../js-c -o bin/client src/client.c
-gcc -I../js-c -o bin/single_player_ui src/single_player_ui.c -lGLX -lX11 -lm -lGL
-gcc -I../js-c -o bin/client_ui src/client_ui.c -lGLX -lX11 -lm -lGL
+# -march=native selects the pext slider lookup on BMI2 hosts
+CFLAGS="-march=native"
+
+# precomputed geometry tables, picked up by chess.h when present
+gcc $CFLAGS -o bin/chess_gen src/chess_gen.c
+bin/chess_gen > src/chess_tables.h
+
+gcc $CFLAGS -O2 -I../js-c -o bin/single_player src/single_player.c -lpthread
+gcc $CFLAGS -I../js-c -o bin/server src/server.c
+gcc $CFLAGS -I../js-c -o bin/client src/client.c
+gcc $CFLAGS -O2 -I../js-c -o bin/single_player_ui src/single_player_ui.c -lGLX -lX11 -lm -lGL -lpthread
+gcc $CFLAGS -I../js-c -o bin/client_ui src/client_ui.c -lGLX -lX11 -lm -lGL
+gcc $CFLAGS -O2 -o bin/perft src/perft.c -lpthread
+gcc $CFLAGS -O2 -o bin/bench src/bench.c -lpthread
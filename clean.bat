@@ -1,2 +1,3 @@
 rmdir /s /q bin 2> nul
 del *.obj
+del src\chess_tables.h 2> nul
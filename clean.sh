@@ -1,3 +1,4 @@
 #!/bin/sh -x
 
 rm -rf bin
+rm -f src/chess_tables.h
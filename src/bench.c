@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHESS_IMPLEMENTATION
+#include "chess.h"
+
+#define CHESS_THREAD_IMPLEMENTATION
+#include "chess_thread.h"
+
+#define CHESS_SEARCH_IMPLEMENTATION
+#include "chess_search.h"
+
+// Middlegames, where the threads have something to split
+const char *bench_fens[] = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1QBPPP/R3KB1R w KQ - 0 9",
+  "r2q1rk1/1b1nbppp/p2ppn2/1p6/3NP3/1BN1BP2/PPPQ2PP/2KR3R w - - 0 12",
+  "2rq1rk1/pb2bppp/1pn1pn2/2pp4/3P4/1PP1PNP1/PB1NQPBP/R4RK1 w - - 0 11",
+  "r1b2rk1/2q1bppp/p2p1n2/npp1p3/3PP3/2P2N1P/PPBN1PP1/R1BQR1K1 w - - 0 12",
+};
+#define BENCH_FENS_LEN (sizeof(bench_fens) / sizeof(bench_fens[0]))
+
+void usage(char *program) {
+  fprintf(stderr, "USAGE: %s [-depth <n>] [-threads <max>] [-hash <mb>]\n", program);
+}
+
+int main(int argc, char **argv) {
+
+  char *program = argv[0];
+  int depth = 9;
+  int threads_max = chess_thread_count();
+  int hash_mb = 64;
+
+  for(int i=1;i<argc;i++) {
+    if(strcmp(argv[i], "-depth") == 0 && i + 1 < argc) {
+      depth = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+      threads_max = atoi(argv[++i]);
+      if(threads_max < 1) threads_max = 1;
+    } else if(strcmp(argv[i], "-hash") == 0 && i + 1 < argc) {
+      hash_mb = atoi(argv[++i]);
+    } else {
+      usage(program);
+      return 1;
+    }
+  }
+
+  Chess_Search_Table table;
+  if(!chess_search_table_init(&table, (unsigned long long) hash_mb)) {
+    fprintf(stderr, "ERROR: Cannot allocate %d MB for the hash\n", hash_mb);
+    return 1;
+  }
+
+  Chess_Game game;
+  chess_game_default(&game);
+
+  printf("depth %d, %d MB hash, %d positions\n\n", depth, hash_mb, (int) BENCH_FENS_LEN);
+  printf("threads    time (s)       nodes         nps   time-to-depth   nps\n");
+  printf("                                                   speedup   speedup\n");
+
+  double base_time = 0, base_nps = 0;
+  int threads = 1;
+  while(1) {
+    double time = 0;
+    unsigned long long nodes = 0;
+
+    for(size_t i=0;i<BENCH_FENS_LEN;i++) {
+      if(!chess_game_from_fen(&game, bench_fens[i])) {
+	fprintf(stderr, "ERROR: Cannot parse fen '%s'\n", bench_fens[i]);
+	return 1;
+      }
+      // every run starts from an empty table
+      chess_search_table_clear(&table);
+
+      Chess_Search_Limits limits = {0};
+      limits.depth = depth;
+      limits.threads = threads;
+      Chess_Search_Result result;
+      chess_search(&game, &table, limits, &result);
+      time += result.seconds;
+      nodes += result.nodes;
+    }
+
+    double nps = time > 0 ? (double) nodes / time : 0;
+    if(threads == 1) {
+      base_time = time;
+      base_nps = nps;
+    }
+    printf("%7d %11.3f %11llu %11.0f %15.2f %9.2f\n",
+	   threads, time, nodes, nps,
+	   time > 0 ? base_time / time : 0,
+	   base_nps > 0 ? nps / base_nps : 0);
+    fflush(stdout);
+
+    // doubling, the last step goes to threads_max
+    if(threads >= threads_max) {
+      break;
+    }
+    threads = threads * 2 < threads_max ? threads * 2 : threads_max;
+  }
+
+  chess_search_table_free(&table);
+  chess_game_free(&game);
+
+  return 0;
+}
@@ -10,6 +10,73 @@
 #  define CHESS_ASSERT assert
 #endif // CHESS_ASSERT
 
+#ifndef CHESS_REALLOC
+#  include <stdlib.h>
+#  define CHESS_REALLOC realloc
+#  define CHESS_FREE free
+#endif // CHESS_REALLOC
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif // _MSC_VER
+
+// One bit per square, bit k corresponds to board[k]
+typedef unsigned long long Chess_Bitboard;
+
+#define CHESS_BIT(pos) (((Chess_Bitboard) 1) << (pos))
+#define CHESS_FILE_A ((Chess_Bitboard) 0x0101010101010101ULL)
+#define CHESS_FILE_B (CHESS_FILE_A << 1)
+#define CHESS_FILE_G (CHESS_FILE_A << 6)
+#define CHESS_FILE_H (CHESS_FILE_A << 7)
+#define CHESS_ROW(y) (((Chess_Bitboard) 0xff) << ((y) * 8))
+
+// Fills the attack and hashing tables, called by chess_game_reset.
+// Safe to call from many threads, only the first one does the work
+CHESS_DEF void chess_tables_init(void);
+
+CHESS_DEF int chess_bitboard_count(Chess_Bitboard b);
+CHESS_DEF int chess_bitboard_first(Chess_Bitboard b);
+CHESS_DEF int chess_bitboard_pop(Chess_Bitboard *b);
+CHESS_DEF Chess_Bitboard chess_bitboard_knight_attacks(Chess_Bitboard b);
+CHESS_DEF Chess_Bitboard chess_bitboard_king_attacks(Chess_Bitboard b);
+CHESS_DEF Chess_Bitboard chess_bitboard_pawn_attacks(Chess_Bitboard b, int black);
+CHESS_DEF Chess_Bitboard chess_bitboard_ray(int pos, int dx, int dy, Chess_Bitboard occupied);
+CHESS_DEF Chess_Bitboard chess_bitboard_bishop_rays(int pos, Chess_Bitboard occupied);
+CHESS_DEF Chess_Bitboard chess_bitboard_rook_rays(int pos, Chess_Bitboard occupied);
+
+// Slider attacks are looked up in precomputed tables. The index into a
+// table is either a 'magic' multiply and shift of the relevant occupancy
+// or, on hosts with BMI2 (compiled with -mbmi2 or -march=native), a pext.
+#if defined(__BMI2__) && !defined(CHESS_NO_PEXT)
+#  define CHESS_PEXT
+#  include <immintrin.h>
+#endif // __BMI2__
+
+typedef struct {
+  Chess_Bitboard mask;
+  Chess_Bitboard magic;
+  int shift;
+  int offset;
+} Chess_Magic;
+
+#define CHESS_ROOK_TABLE_LEN   102400
+#define CHESS_BISHOP_TABLE_LEN 5248
+
+CHESS_DEF Chess_Bitboard chess_bitboard_bishop_attacks(int pos, Chess_Bitboard occupied);
+CHESS_DEF Chess_Bitboard chess_bitboard_rook_attacks(int pos, Chess_Bitboard occupied);
+CHESS_DEF Chess_Bitboard chess_bitboard_queen_attacks(int pos, Chess_Bitboard occupied);
+CHESS_DEF Chess_Bitboard chess_bitboard_between(int a, int b);
+CHESS_DEF Chess_Bitboard chess_bitboard_line(int a, int b);
+
+// The geometry and hashing tables come from src/chess_tables.h, which
+// the build generates with src/chess_gen.c. Without it,
+// chess_tables_init computes them at startup
+#if !defined(CHESS_NO_GENERATED_TABLES) && defined(__has_include)
+#  if __has_include("chess_tables.h")
+#    define CHESS_GENERATED_TABLES
+#  endif
+#endif
+
 typedef enum {
   CHESS_KIND_NONE = 0,
   CHESS_KIND_PAWN,
@@ -20,74 +87,677 @@ typedef enum {
   CHESS_KIND_KING,
 } Chess_Kind;
 
-typedef struct {
-  Chess_Kind kind;
-  int black;
-} Chess_Piece;
+// A piece packed into one byte, the kind in the lower 3 bits and the
+// color in the 4th. An empty square is 0
+typedef unsigned char Chess_Piece;
 
-CHESS_DEF void chess_piece_from_char(char c, Chess_Piece *p); 
+#define CHESS_PIECE_BLACK 0x8
+#define CHESS_PIECE_NONE ((Chess_Piece) 0)
+#define CHESS_PIECE(kind, black) ((Chess_Piece) ((kind) | ((black) ? CHESS_PIECE_BLACK : 0)))
 
-typedef struct {
-  int from;
-  int to;
-} Chess_Move;	
+CHESS_DEF Chess_Kind chess_piece_kind(Chess_Piece p);
+CHESS_DEF int chess_piece_black(Chess_Piece p);
+
+// Returns 0 for a char, that is no piece
+CHESS_DEF int chess_piece_from_char(char c, Chess_Piece *p);
+
+// A move packed into 16 bits:
+//   bits  0..5   from
+//   bits  6..11  to
+//   bits 12..15  CHESS_MOVE_FLAG_*
+typedef unsigned short Chess_Move;
 
-CHESS_DEF int chess_move_eq(Chess_Move *a, Chess_Move *b); 
+#define CHESS_MOVE_FLAG_CASTLE     0x1
+#define CHESS_MOVE_FLAG_EN_PASSANT 0x2
+#define CHESS_MOVE_FLAG_PROMOTION  0x8 // the lower 2 bits select the kind
+
+#define CHESS_MOVE(from, to, flags) ((Chess_Move) ((from) | ((to) << 6) | ((flags) << 12)))
+#define CHESS_MOVE_PROMOTION(kind) (CHESS_MOVE_FLAG_PROMOTION | ((kind) - CHESS_KIND_KNIGHT))
+
+CHESS_DEF int chess_move_from(Chess_Move m);
+CHESS_DEF int chess_move_to(Chess_Move m);
+CHESS_DEF int chess_move_flags(Chess_Move m);
+CHESS_DEF Chess_Kind chess_move_promotion(Chess_Move m);
 CHESS_DEF int chess_move_from_cstr(char *cstr, Chess_Move *move);
+CHESS_DEF void chess_move_to_cstr(Chess_Move move, char *cstr);
+
+// Enough for "e7 e8q" and the terminator
+#define CHESS_MOVE_CSTR_CAP 8
+
+// Zobrist hash of a position
+typedef unsigned long long Chess_Key;
+
+// Everything needed to take back a move, without replaying the game
+typedef struct {
+  Chess_Piece captured;
+  int en_passant;
+  int castling;
+  int halfmove;
+  Chess_Key key;
+} Chess_Undo;
 
 #define CHESS_N 8
+
+// Moves stored inside of Chess_Game. Longer games spill into storage
+// from CHESS_REALLOC, which is kept until chess_game_free
 #define CHESS_HISTORY_CAP 63
 
+// Castling rights, one bit per king and rook pair
+#define CHESS_CASTLE_WHITE_LEFT  0x1
+#define CHESS_CASTLE_WHITE_RIGHT 0x2
+#define CHESS_CASTLE_BLACK_LEFT  0x4
+#define CHESS_CASTLE_BLACK_RIGHT 0x8
+#define CHESS_CASTLE_ALL         0xf
+
+// Chess_Game.eval is tapered between its two stages by Chess_Game.phase,
+// which counts 1 per knight and bishop, 2 per rook and 4 per queen
+#define CHESS_EVAL_MIDDLEGAME 0
+#define CHESS_EVAL_ENDGAME    1
+#define CHESS_EVAL_PHASE_MAX  24
+
+typedef enum {
+  CHESS_STATUS_PLAYING = 0,
+  CHESS_STATUS_CHECKMATE,  // the player, whose turn it is, lost
+  CHESS_STATUS_STALEMATE,
+} Chess_Status;
+
 typedef struct {
+  Chess_Piece board[CHESS_N * CHESS_N]; // 64 bytes, one per square
   int blacks_turn;
-  Chess_Piece board[CHESS_N * CHESS_N];
+  Chess_Bitboard kinds[CHESS_KIND_KING + 1]; // indexed by Chess_Kind
+  Chess_Bitboard colors[2];                  // indexed by chess_piece_black
+  int kings[2];                              // indexed by chess_piece_black
+  int en_passant; // square a pawn can capture 'En passant' or -1
+  int castling;   // CHESS_CASTLE_*
+  int halfmove;   // plies since the last capture or pawn move
+  int fullmove;   // starts at 1, incremented after black moved
+  Chess_Key key;  // covers board, turn, castling and 'En passant' file
+  int eval[2];    // material and squares, white minus black, by CHESS_EVAL_*
+  int phase;      // CHESS_EVAL_PHASE_MAX at the start, can exceed it after promotions
   Chess_Move history[CHESS_HISTORY_CAP];
+  Chess_Undo undo[CHESS_HISTORY_CAP];
+  Chess_Move *more_history; // moves past CHESS_HISTORY_CAP
+  Chess_Undo *more_undo;
+  int more_cap;
   int history_len;
+  struct Chess_Targets *targets; // see chess_game_legal_targets
 } Chess_Game;
 
+// The legal destinations of every square, for the position with key
+typedef struct Chess_Targets {
+  Chess_Key key;
+  Chess_Bitboard to[CHESS_N * CHESS_N];
+} Chess_Targets;
+
 CHESS_DEF void chess_game_reset(Chess_Game *g); 
 CHESS_DEF void chess_game_default(Chess_Game *g); 
+CHESS_DEF void chess_game_free(Chess_Game *g);
+CHESS_DEF int chess_game_copy(Chess_Game *dst, Chess_Game *src);
+CHESS_DEF int chess_game_reserve(Chess_Game *g, int history_len);
+CHESS_DEF Chess_Move chess_game_history_at(Chess_Game *g, int i);
 CHESS_DEF void chess_game_dump(Chess_Game *g);
+CHESS_DEF int chess_game_from_fen(Chess_Game *g, const char *fen);
+CHESS_DEF void chess_game_to_fen(Chess_Game *g, char *cstr);
 CHESS_DEF void chess_game_rewind(Chess_Game *g, int rewind_to);
+CHESS_DEF void chess_game_unmake(Chess_Game *g);
 CHESS_DEF int chess_game_is_check(Chess_Game *g);
 CHESS_DEF int chess_game_move(Chess_Game *g, Chess_Move *m);
 CHESS_DEF int chess_game_over(Chess_Game *g, int *white_or_black_won);
-
-CHESS_DEF int chess_game_check_path(Chess_Game *g,
-				    int src_x,
-				    int src_y,
-				    int dst_x,
-				    int dst_y,
-				    int dx_n,
-				    int dy_n);
-CHESS_DEF int chess_game_validate_move_bishop(Chess_Game *g,
-					      int src_x,
-					      int src_y,
-					      int dst_x,
-					      int dst_y,
-					      int dx_abs,
-					      int dy_abs,
-					      int dx_n,				    
-					      int dy_n);
-CHESS_DEF int chess_game_validate_move_rook(Chess_Game *g,
-					    int src_x,
-					    int src_y,
-					    int dst_x,
-					    int dst_y,
-					    int dx_abs,
-					    int dy_abs,
-					    int dx_n,
-					    int dy_n);
-CHESS_DEF int chess_game_piece_has_moved(Chess_Game *g, int pos);
-CHESS_DEF int chess_game_validate_move(Chess_Game *g, Chess_Move *m);
-CHESS_DEF void chess_game_perform_move_impl(Chess_Game *g, Chess_Move *m);
-CHESS_DEF void chess_game_perform_move(Chess_Game *g, Chess_Move *m);
+CHESS_DEF int chess_game_has_legal_move(Chess_Game *g);
+CHESS_DEF Chess_Status chess_game_status(Chess_Game *g);
+CHESS_DEF Chess_Bitboard chess_game_legal_targets(Chess_Game *g, int from);
+CHESS_DEF void chess_game_put_piece(Chess_Game *g, int pos, Chess_Piece p);
+CHESS_DEF Chess_Piece chess_game_remove_piece(Chess_Game *g, int pos);
+CHESS_DEF Chess_Bitboard chess_game_occupied(Chess_Game *g);
+CHESS_DEF int chess_game_is_attacked(Chess_Game *g, int pos, int by_black);
+CHESS_DEF Chess_Bitboard chess_game_attackers(Chess_Game *g, int pos, int by_black, Chess_Bitboard occupied);
+CHESS_DEF Chess_Bitboard chess_game_checkers(Chess_Game *g);
+CHESS_DEF Chess_Bitboard chess_game_pinned(Chess_Game *g);
+CHESS_DEF Chess_Key chess_game_compute_key(Chess_Game *g);
+
+CHESS_DEF int chess_game_can_castle(Chess_Game *g, Chess_Move king_move);
+CHESS_DEF Chess_Move chess_game_complete_move(Chess_Game *g, Chess_Move m);
+CHESS_DEF int chess_game_validate_move(Chess_Game *g, Chess_Move m);
+CHESS_DEF void chess_game_perform_move_impl(Chess_Game *g, int from, int to);
+CHESS_DEF int chess_game_perform_move(Chess_Game *g, Chess_Move m);
 CHESS_DEF int chess_game_king_position(Chess_Game *g);
 CHESS_DEF int chess_game_available_moves(Chess_Game *g);
 
+// Enough for any position, including both move counters
+#define CHESS_FEN_CAP 128
+
+// Upper bound for the number of moves in any position
+#define CHESS_MOVES_CAP 256
+
+// What chess_game_generate produces. Captures include every
+// promotion and 'En passant', quiets include castling
+#define CHESS_GENERATE_CAPTURES 0x1
+#define CHESS_GENERATE_QUIETS   0x2
+#define CHESS_GENERATE_ALL      (CHESS_GENERATE_CAPTURES | CHESS_GENERATE_QUIETS)
+
+CHESS_DEF int chess_game_generate(Chess_Game *g, int which, Chess_Move *out, int cap);
+CHESS_DEF int chess_game_generate_legal(Chess_Game *g, int which, Chess_Move *out, int cap);
+CHESS_DEF int chess_game_generate_moves(Chess_Game *g, Chess_Move *out, int cap);
+CHESS_DEF int chess_game_generate_legal_moves(Chess_Game *g, Chess_Move *out, int cap);
+CHESS_DEF int chess_game_filter_legal(Chess_Game *g, Chess_Move *moves, int len);
+CHESS_DEF int chess_game_is_legal(Chess_Game *g, Chess_Move m);
+
+// A position without its history, about 76 bytes
+typedef struct {
+  Chess_Piece board[CHESS_N * CHESS_N];
+  signed char en_passant;
+  unsigned char castling;
+  unsigned char blacks_turn;
+  unsigned short halfmove;
+  int fullmove;
+} Chess_Snapshot;
+
+// The moves of a game, with a snapshot every interval plies, so
+// seeking to any ply replays at most interval - 1 moves. A smaller
+// interval trades memory for faster seeks
+typedef struct {
+  int interval;
+  Chess_Move *moves;
+  int moves_len;
+  int moves_cap;
+  Chess_Snapshot *snapshots; // snapshots[i] is the position at ply i * interval
+  int snapshots_len;
+  int snapshots_cap;
+} Chess_Timeline;
+
+#define CHESS_TIMELINE_DEFAULT_INTERVAL 16
+
+CHESS_DEF void chess_snapshot_take(Chess_Snapshot *s, Chess_Game *g);
+CHESS_DEF void chess_snapshot_load(Chess_Snapshot *s, Chess_Game *g);
+
+CHESS_DEF int chess_timeline_init(Chess_Timeline *t, Chess_Game *start, int interval);
+CHESS_DEF void chess_timeline_free(Chess_Timeline *t);
+CHESS_DEF int chess_timeline_push(Chess_Timeline *t, Chess_Game *g, Chess_Move m);
+CHESS_DEF void chess_timeline_truncate(Chess_Timeline *t, int ply);
+CHESS_DEF int chess_timeline_seek(Chess_Timeline *t, Chess_Game *g, int ply);
+
 #ifdef CHESS_IMPLEMENTATION
 
-char chess_kind_char[] = {
+CHESS_DEF int chess_bitboard_count(Chess_Bitboard b) {
+#ifdef _MSC_VER
+  return (int) __popcnt64(b);
+#else
+  return __builtin_popcountll(b);
+#endif // _MSC_VER
+}
+
+CHESS_DEF int chess_bitboard_first(Chess_Bitboard b) {
+  CHESS_ASSERT(b);
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, b);
+  return (int) index;
+#else
+  return __builtin_ctzll(b);
+#endif // _MSC_VER
+}
+
+CHESS_DEF int chess_bitboard_pop(Chess_Bitboard *b) {
+  int pos = chess_bitboard_first(*b);
+  *b &= *b - 1;
+  return pos;
+}
+
+CHESS_DEF Chess_Bitboard chess_bitboard_knight_attacks(Chess_Bitboard b) {
+  Chess_Bitboard l1 = (b >> 1) & ~CHESS_FILE_H;
+  Chess_Bitboard l2 = (b >> 2) & ~(CHESS_FILE_G | CHESS_FILE_H);
+  Chess_Bitboard r1 = (b << 1) & ~CHESS_FILE_A;
+  Chess_Bitboard r2 = (b << 2) & ~(CHESS_FILE_A | CHESS_FILE_B);
+  Chess_Bitboard h1 = l1 | r1;
+  Chess_Bitboard h2 = l2 | r2;
+  return (h1 << 16) | (h1 >> 16) | (h2 << 8) | (h2 >> 8);
+}
+
+CHESS_DEF Chess_Bitboard chess_bitboard_king_attacks(Chess_Bitboard b) {
+  Chess_Bitboard attacks = ((b >> 1) & ~CHESS_FILE_H) | ((b << 1) & ~CHESS_FILE_A);
+  b |= attacks;
+  return attacks | (b << CHESS_N) | (b >> CHESS_N);
+}
+
+CHESS_DEF Chess_Bitboard chess_bitboard_pawn_attacks(Chess_Bitboard b, int black) {
+  // white pawns move towards row 0, black pawns towards row CHESS_N-1
+  Chess_Bitboard forward = black ? (b << CHESS_N) : (b >> CHESS_N);
+  return ((forward >> 1) & ~CHESS_FILE_H) | ((forward << 1) & ~CHESS_FILE_A);
+}
+
+CHESS_DEF Chess_Bitboard chess_bitboard_ray(int pos, int dx, int dy, Chess_Bitboard occupied) {
+  Chess_Bitboard attacks = 0;
+
+  int x = pos % CHESS_N + dx;
+  int y = pos / CHESS_N + dy;
+  while(0 <= x && x < CHESS_N &&
+	0 <= y && y < CHESS_N) {
+    Chess_Bitboard b = CHESS_BIT(y * CHESS_N + x);
+    attacks |= b;
+    if(occupied & b) {
+      break;
+    }
+
+    x += dx;
+    y += dy;
+  }
+
+  return attacks;
+}
+
+CHESS_DEF Chess_Bitboard chess_bitboard_bishop_rays(int pos, Chess_Bitboard occupied) {
+  return
+    chess_bitboard_ray(pos,  1,  1, occupied) |
+    chess_bitboard_ray(pos,  1, -1, occupied) |
+    chess_bitboard_ray(pos, -1,  1, occupied) |
+    chess_bitboard_ray(pos, -1, -1, occupied);
+}
+
+CHESS_DEF Chess_Bitboard chess_bitboard_rook_rays(int pos, Chess_Bitboard occupied) {
+  return
+    chess_bitboard_ray(pos,  1,  0, occupied) |
+    chess_bitboard_ray(pos, -1,  0, occupied) |
+    chess_bitboard_ray(pos,  0,  1, occupied) |
+    chess_bitboard_ray(pos,  0, -1, occupied);
+}
+
+static const Chess_Bitboard chess_rook_magic_numbers[CHESS_N * CHESS_N] = {
+  0x1080004008801020ULL, 0x0840092002c03000ULL, 0x1900200010400900ULL,
+  0x0880100008000480ULL, 0x4200100420080200ULL, 0x8100020100080400ULL,
+  0x0200040110886200ULL, 0x0200008040220411ULL, 0x0404800084400220ULL,
+  0x0000401000402000ULL, 0x0086001081220440ULL, 0x0408800800100280ULL,
+  0x000a001201040820ULL, 0x8848800200840080ULL, 0x4001000100040200ULL,
+  0x0442000102105084ULL, 0x9080010020804100ULL, 0x0040404000201009ULL,
+  0x0000808010002009ULL, 0x2200090021d00100ULL, 0x0008008008040080ULL,
+  0x0004004002010040ULL, 0x0011040008015042ULL, 0x00000a0001768104ULL,
+  0x0000800080204009ULL, 0x2010004140002001ULL, 0x9800200280100080ULL,
+  0x1000100080080080ULL, 0x0442000a00049020ULL, 0x2100040080020080ULL,
+  0x0800120400900148ULL, 0x0010040a00128541ULL, 0x2800804000800030ULL,
+  0x1010002000400041ULL, 0x4000200011004100ULL, 0x0610008410800800ULL,
+  0x0400802402800800ULL, 0xc100020080800400ULL, 0x0002000802000401ULL,
+  0x0182085882000401ULL, 0x0220204000808000ULL, 0x2860100040024022ULL,
+  0x0001002004110040ULL, 0x99101042000a0020ULL, 0x0004080004008080ULL,
+  0x0010040002008080ULL, 0x2012004881020004ULL, 0x8300842444820011ULL,
+  0x0088403882010200ULL, 0x0820400080210100ULL, 0x0110910040a00300ULL,
+  0x0801100280080480ULL, 0x0242009008200600ULL, 0x1002000489500200ULL,
+  0x0040800200010080ULL, 0x0091800041000080ULL, 0x0000209300488001ULL,
+  0x04c1002414824001ULL, 0x020020000b001041ULL, 0x7000100004200901ULL,
+  0x8002002004100802ULL, 0x30010002084c0007ULL, 0x0888221800813004ULL,
+  0x4000002840840112ULL,
+};
+
+static const Chess_Bitboard chess_bishop_magic_numbers[CHESS_N * CHESS_N] = {
+  0xa010041108003100ULL, 0x006082020a002900ULL, 0x6810010619200000ULL,
+  0x08281a0520000408ULL, 0x0001104001000400ULL, 0x0018901008048400ULL,
+  0x00040a0210245280ULL, 0x000200210808a402ULL, 0x9140048410821200ULL,
+  0x0800091010820041ULL, 0x20504804832202c0ULL, 0x0100091401081000ULL,
+  0x8021011140000012ULL, 0x0810020804450400ULL, 0x208b0542109008a2ULL,
+  0x0080084a08040204ULL, 0x0040e2a80811244cULL, 0x2505022008008108ULL,
+  0x0430220100420040ULL, 0x010a040420220040ULL, 0x1105000290400000ULL,
+  0x0093001200822120ULL, 0x4000a62048043004ULL, 0x280120048a015004ULL,
+  0x006090002a020814ULL, 0x44042000240800d0ULL, 0x01102800040a4400ULL,
+  0x1004080080220040ULL, 0x0001001011004024ULL, 0x0010044000805040ULL,
+  0x0914041200820100ULL, 0x0004821012821480ULL, 0x0024040500c05021ULL,
+  0x0088611002080200ULL, 0x0116080a00040020ULL, 0x4000020080080080ULL,
+  0x2450450140840040ULL, 0x0000880201484100ULL, 0x0222020404020092ULL,
+  0x8081110600002e00ULL, 0x2842101105000801ULL, 0x1100809008001025ULL,
+  0x00020202221c0400ULL, 0x0422014022009020ULL, 0x0210046102100c00ULL,
+  0xc004008082029102ULL, 0x00aa461801101200ULL, 0x0404080080201108ULL,
+  0x020542108c205002ULL, 0x0410544804100100ULL, 0x0040910841100000ULL,
+  0x0400200042021100ULL, 0x00004204850400c0ULL, 0x0200100410a42102ULL,
+  0x1040020801210102ULL, 0x0805040410420000ULL, 0x2884804130100200ULL,
+  0x800c262201242000ULL, 0x1058000194108800ULL, 0x0014221054420204ULL,
+  0x0104000012a02200ULL, 0x0200881003300100ULL, 0x0140400202840100ULL,
+  0x0402020801010201ULL,
+};
+
+// 0 untouched, 1 being filled, 2 ready
+static volatile long chess_tables_state = 0;
+
+#ifdef CHESS_GENERATED_TABLES
+#  include "chess_tables.h"
+#else
+static Chess_Key chess_zobrist_pieces[2][CHESS_KIND_KING + 1][CHESS_N * CHESS_N];
+static Chess_Key chess_zobrist_castling[CHESS_CASTLE_ALL + 1];
+static Chess_Key chess_zobrist_en_passant[CHESS_N];
+static Chess_Key chess_zobrist_black;
+static Chess_Bitboard chess_knight_table[CHESS_N * CHESS_N];
+static Chess_Bitboard chess_king_table[CHESS_N * CHESS_N];
+static Chess_Bitboard chess_pawn_table[2][CHESS_N * CHESS_N];        // attacks, indexed by color
+static Chess_Bitboard chess_between_table[CHESS_N * CHESS_N][CHESS_N * CHESS_N]; // exclusive
+static Chess_Bitboard chess_line_table[CHESS_N * CHESS_N][CHESS_N * CHESS_N];    // the whole line
+static signed char chess_dir_table[CHESS_N * CHESS_N][CHESS_N * CHESS_N];        // step or 0
+#endif // CHESS_GENERATED_TABLES
+static Chess_Magic chess_rook_magics[CHESS_N * CHESS_N];
+static Chess_Magic chess_bishop_magics[CHESS_N * CHESS_N];
+static Chess_Bitboard chess_slider_table[CHESS_ROOK_TABLE_LEN + CHESS_BISHOP_TABLE_LEN];
+
+static inline int chess_magic_index(const Chess_Magic *m, Chess_Bitboard occupied) {
+#ifdef CHESS_PEXT
+  return m->offset + (int) _pext_u64(occupied, m->mask);
+#else
+  return m->offset + (int) (((occupied & m->mask) * m->magic) >> m->shift);
+#endif // CHESS_PEXT
+}
+
+static inline int chess_magic_init(Chess_Magic *m, int pos, Chess_Bitboard magic, int rook, int offset) {
+  // the squares at the end of a ray do not block anything
+  Chess_Bitboard edges =
+    ((CHESS_ROW(0) | CHESS_ROW(CHESS_N - 1)) & ~CHESS_ROW(pos / CHESS_N)) |
+    ((CHESS_FILE_A | CHESS_FILE_H) & ~(CHESS_FILE_A << (pos % CHESS_N)));
+  
+  if(rook) {
+    m->mask = chess_bitboard_rook_rays(pos, 0) & ~edges;
+  } else {
+    m->mask = chess_bitboard_bishop_rays(pos, 0) & ~edges;
+  }
+  int bits = chess_bitboard_count(m->mask);
+  m->magic = magic;
+  m->shift = 64 - bits;
+  m->offset = offset;
+
+  // visit every subset of the mask
+  Chess_Bitboard occupied = 0;
+  do {
+    Chess_Bitboard attacks;
+    if(rook) {
+      attacks = chess_bitboard_rook_rays(pos, occupied);
+    } else {
+      attacks = chess_bitboard_bishop_rays(pos, occupied);
+    }
+    chess_slider_table[chess_magic_index(m, occupied)] = attacks;
+    occupied = (occupied - m->mask) & m->mask;
+  } while(occupied);
+
+  return offset + (1 << bits);
+}
+
+static inline Chess_Key chess_zobrist_next(Chess_Key *state) {
+  // splitmix64, the keys must be the same in every process
+  Chess_Key z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+#ifndef CHESS_GENERATED_TABLES
+static inline void chess_geometry_init(void) {
+  for(int a=0;a<CHESS_N*CHESS_N;a++) {
+    chess_knight_table[a] = chess_bitboard_knight_attacks(CHESS_BIT(a));
+    chess_king_table[a] = chess_bitboard_king_attacks(CHESS_BIT(a));
+    chess_pawn_table[0][a] = chess_bitboard_pawn_attacks(CHESS_BIT(a), 0);
+    chess_pawn_table[1][a] = chess_bitboard_pawn_attacks(CHESS_BIT(a), 1);
+
+    for(int b=0;b<CHESS_N*CHESS_N;b++) {
+      chess_between_table[a][b] = 0;
+      chess_line_table[a][b] = 0;
+      chess_dir_table[a][b] = 0;
+      
+      int dx = b % CHESS_N - a % CHESS_N;
+      int dy = b / CHESS_N - a / CHESS_N;
+      if(a == b || (dx != 0 && dy != 0 && dx != dy && dx != -dy)) {
+	continue;
+      }
+
+      int dx_n = (dx > 0) - (dx < 0);
+      int dy_n = (dy > 0) - (dy < 0);
+      chess_between_table[a][b] =
+	chess_bitboard_ray(a, dx_n, dy_n, CHESS_BIT(b)) & ~CHESS_BIT(b);
+      chess_line_table[a][b] =
+	chess_bitboard_ray(a,  dx_n,  dy_n, 0) |
+	chess_bitboard_ray(a, -dx_n, -dy_n, 0) |
+	CHESS_BIT(a);
+      chess_dir_table[a][b] = (signed char) (dy_n * CHESS_N + dx_n);
+    }
+  }
+}
+
+static inline void chess_zobrist_init(void) {
+  Chess_Key state = 0;
+  for(int c=0;c<2;c++) {
+    for(int k=0;k<CHESS_KIND_KING+1;k++) {
+      for(int pos=0;pos<CHESS_N*CHESS_N;pos++) {
+	chess_zobrist_pieces[c][k][pos] = chess_zobrist_next(&state);
+      }
+    }
+  }
+  for(int c=0;c<CHESS_CASTLE_ALL+1;c++) {
+    chess_zobrist_castling[c] = chess_zobrist_next(&state);
+  }
+  for(int x=0;x<CHESS_N;x++) {
+    chess_zobrist_en_passant[x] = chess_zobrist_next(&state);
+  }
+  chess_zobrist_black = chess_zobrist_next(&state);
+}
+#endif // CHESS_GENERATED_TABLES
+
+static inline long chess_tables_state_load(void) {
+#ifdef _MSC_VER
+  return _InterlockedOr(&chess_tables_state, 0);
+#else
+  return __atomic_load_n(&chess_tables_state, __ATOMIC_ACQUIRE);
+#endif // _MSC_VER
+}
+
+static inline int chess_tables_claim(void) {
+  // 1, if the caller moved the state from 0 to 1 and must fill
+#ifdef _MSC_VER
+  return _InterlockedCompareExchange(&chess_tables_state, 1, 0) == 0;
+#else
+  long expected = 0;
+  return __atomic_compare_exchange_n(&chess_tables_state, &expected, 1, 0,
+				     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif // _MSC_VER
+}
+
+static inline void chess_tables_ready(void) {
+#ifdef _MSC_VER
+  _InterlockedExchange(&chess_tables_state, 2);
+#else
+  __atomic_store_n(&chess_tables_state, 2, __ATOMIC_RELEASE);
+#endif // _MSC_VER
+}
+
+// Piece values, by CHESS_EVAL_* stage
+static const int chess_eval_piece[2][CHESS_KIND_KING + 1] = {
+  { 0, 100, 320, 330, 500, 900, 0 },
+  { 0, 120, 300, 320, 530, 930, 0 },
+};
+
+static const int chess_eval_phase[CHESS_KIND_KING + 1] = { 0, 0, 1, 1, 2, 4, 0 };
+
+// Bonus by square for white, by CHESS_EVAL_* stage, board[0] is a8.
+// Black looks up the square mirrored along the middle rank
+static const int chess_eval_square[2][CHESS_KIND_KING + 1][CHESS_N * CHESS_N] = {
+  {
+    [CHESS_KIND_PAWN] = {
+        0,   0,   0,   0,   0,   0,   0,   0,
+       50,  50,  50,  50,  50,  50,  50,  50,
+       10,  10,  20,  30,  30,  20,  10,  10,
+        5,   5,  10,  25,  25,  10,   5,   5,
+        0,   0,   0,  20,  20,   0,   0,   0,
+        5,  -5, -10,   0,   0, -10,  -5,   5,
+        5,  10,  10, -20, -20,  10,  10,   5,
+        0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    [CHESS_KIND_KNIGHT] = {
+      -50, -40, -30, -30, -30, -30, -40, -50,
+      -40, -20,   0,   0,   0,   0, -20, -40,
+      -30,   0,  10,  15,  15,  10,   0, -30,
+      -30,   5,  15,  20,  20,  15,   5, -30,
+      -30,   0,  15,  20,  20,  15,   0, -30,
+      -30,   5,  10,  15,  15,  10,   5, -30,
+      -40, -20,   0,   5,   5,   0, -20, -40,
+      -50, -40, -30, -30, -30, -30, -40, -50,
+    },
+    [CHESS_KIND_BISHOP] = {
+      -20, -10, -10, -10, -10, -10, -10, -20,
+      -10,   0,   0,   0,   0,   0,   0, -10,
+      -10,   0,   5,  10,  10,   5,   0, -10,
+      -10,   5,   5,  10,  10,   5,   5, -10,
+      -10,   0,  10,  10,  10,  10,   0, -10,
+      -10,  10,  10,  10,  10,  10,  10, -10,
+      -10,   5,   0,   0,   0,   0,   5, -10,
+      -20, -10, -10, -10, -10, -10, -10, -20,
+    },
+    [CHESS_KIND_ROOK] = {
+        0,   0,   0,   0,   0,   0,   0,   0,
+        5,  10,  10,  10,  10,  10,  10,   5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+        0,   0,   0,   5,   5,   0,   0,   0,
+    },
+    [CHESS_KIND_QUEEN] = {
+      -20, -10, -10,  -5,  -5, -10, -10, -20,
+      -10,   0,   0,   0,   0,   0,   0, -10,
+      -10,   0,   5,   5,   5,   5,   0, -10,
+       -5,   0,   5,   5,   5,   5,   0,  -5,
+        0,   0,   5,   5,   5,   5,   0,  -5,
+      -10,   5,   5,   5,   5,   5,   0, -10,
+      -10,   0,   5,   0,   0,   0,   0, -10,
+      -20, -10, -10,  -5,  -5, -10, -10, -20,
+    },
+    [CHESS_KIND_KING] = {
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -20, -30, -30, -40, -40, -30, -30, -20,
+      -10, -20, -20, -20, -20, -20, -20, -10,
+       20,  20,   0,   0,   0,   0,  20,  20,
+       20,  30,  10,   0,   0,  10,  30,  20,
+    },
+  },
+  {
+    // passed or not, pawns grow in value towards promotion
+    [CHESS_KIND_PAWN] = {
+        0,   0,   0,   0,   0,   0,   0,   0,
+       90,  90,  90,  90,  90,  90,  90,  90,
+       60,  60,  60,  60,  60,  60,  60,  60,
+       35,  35,  35,  35,  35,  35,  35,  35,
+       20,  20,  20,  20,  20,  20,  20,  20,
+       10,  10,  10,  10,  10,  10,  10,  10,
+        0,   0,   0,   0,   0,   0,   0,   0,
+        0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    [CHESS_KIND_KNIGHT] = {
+      -50, -40, -30, -30, -30, -30, -40, -50,
+      -40, -20,   0,   0,   0,   0, -20, -40,
+      -30,   0,  10,  15,  15,  10,   0, -30,
+      -30,   5,  15,  20,  20,  15,   5, -30,
+      -30,   0,  15,  20,  20,  15,   0, -30,
+      -30,   5,  10,  15,  15,  10,   5, -30,
+      -40, -20,   0,   5,   5,   0, -20, -40,
+      -50, -40, -30, -30, -30, -30, -40, -50,
+    },
+    [CHESS_KIND_BISHOP] = {
+      -20, -10, -10, -10, -10, -10, -10, -20,
+      -10,   0,   0,   0,   0,   0,   0, -10,
+      -10,   0,   5,  10,  10,   5,   0, -10,
+      -10,   5,   5,  10,  10,   5,   5, -10,
+      -10,   5,  10,  10,  10,  10,   5, -10,
+      -10,   0,   5,  10,  10,   5,   0, -10,
+      -10,   0,   0,   0,   0,   0,   0, -10,
+      -20, -10, -10, -10, -10, -10, -10, -20,
+    },
+    // the seventh rank and home squares stop mattering
+    [CHESS_KIND_ROOK] = { 0 },
+    [CHESS_KIND_QUEEN] = {
+      -20, -10, -10,  -5,  -5, -10, -10, -20,
+      -10,   0,   5,   5,   5,   5,   0, -10,
+      -10,   5,  10,  10,  10,  10,   5, -10,
+       -5,   5,  10,  15,  15,  10,   5,  -5,
+       -5,   5,  10,  15,  15,  10,   5,  -5,
+      -10,   5,  10,  10,  10,  10,   5, -10,
+      -10,   0,   5,   5,   5,   5,   0, -10,
+      -20, -10, -10,  -5,  -5, -10, -10, -20,
+    },
+    // the king walks to the center, to support the pawns
+    [CHESS_KIND_KING] = {
+      -50, -40, -30, -20, -20, -30, -40, -50,
+      -30, -20, -10,   0,   0, -10, -20, -30,
+      -30, -10,  20,  30,  30,  20, -10, -30,
+      -30, -10,  30,  40,  40,  30, -10, -30,
+      -30, -10,  30,  40,  40,  30, -10, -30,
+      -30, -10,  20,  30,  30,  20, -10, -30,
+      -30, -30,   0,   0,   0,   0, -30, -30,
+      -50, -30, -30, -30, -30, -30, -30, -50,
+    },
+  },
+};
+
+// chess_eval_piece plus chess_eval_square by color, black negative and
+// mirrored. Filled by chess_tables_init
+static int chess_eval_table[2][2][CHESS_KIND_KING + 1][CHESS_N * CHESS_N];
+
+static inline void chess_eval_init(void) {
+  for(int c=0;c<2;c++) {
+    for(int stage=0;stage<2;stage++) {
+      for(int k=0;k<CHESS_KIND_KING+1;k++) {
+	for(int pos=0;pos<CHESS_N*CHESS_N;pos++) {
+	  int value = chess_eval_piece[stage][k] +
+	    chess_eval_square[stage][k][c ? pos ^ ((CHESS_N - 1) * CHESS_N) : pos];
+	  chess_eval_table[c][stage][k][pos] = c ? -value : value;
+	}
+      }
+    }
+  }
+}
+
+CHESS_DEF void chess_tables_init(void) {
+  if(chess_tables_state_load() == 2) {
+    return;
+  }
+  if(!chess_tables_claim()) {
+    // another thread is filling them, the tables are read only after
+    while(chess_tables_state_load() != 2) {}
+    return;
+  }
+
+#ifndef CHESS_GENERATED_TABLES
+  chess_geometry_init();
+  chess_zobrist_init();
+#endif // CHESS_GENERATED_TABLES
+  chess_eval_init();
+
+  int offset = 0;
+  for(int k=0;k<CHESS_N*CHESS_N;k++) {
+    offset = chess_magic_init(&chess_rook_magics[k], k, chess_rook_magic_numbers[k], 1, offset);
+  }
+  for(int k=0;k<CHESS_N*CHESS_N;k++) {
+    offset = chess_magic_init(&chess_bishop_magics[k], k, chess_bishop_magic_numbers[k], 0, offset);
+  }
+  CHESS_ASSERT(offset == CHESS_ROOK_TABLE_LEN + CHESS_BISHOP_TABLE_LEN);
+
+  chess_tables_ready();
+}
+
+CHESS_DEF Chess_Bitboard chess_bitboard_bishop_attacks(int pos, Chess_Bitboard occupied) {
+  return chess_slider_table[chess_magic_index(&chess_bishop_magics[pos], occupied)];
+}
+
+CHESS_DEF Chess_Bitboard chess_bitboard_rook_attacks(int pos, Chess_Bitboard occupied) {
+  return chess_slider_table[chess_magic_index(&chess_rook_magics[pos], occupied)];
+}
+
+CHESS_DEF Chess_Bitboard chess_bitboard_queen_attacks(int pos, Chess_Bitboard occupied) {
+  return
+    chess_bitboard_bishop_attacks(pos, occupied) |
+    chess_bitboard_rook_attacks(pos, occupied);
+}
+
+CHESS_DEF Chess_Bitboard chess_bitboard_between(int a, int b) {
+  return chess_between_table[a][b];
+}
+
+CHESS_DEF Chess_Bitboard chess_bitboard_line(int a, int b) {
+  return chess_line_table[a][b];
+}
+
+static const char chess_kind_char[] = {
   [CHESS_KIND_NONE]   = '_',
   [CHESS_KIND_PAWN]   = 'p',
   [CHESS_KIND_KNIGHT] = 'n',
@@ -97,55 +767,79 @@ char chess_kind_char[] = {
   [CHESS_KIND_KING]   = 'k',
 };
 
-CHESS_DEF void chess_piece_from_char(char c, Chess_Piece *p) {
+CHESS_DEF Chess_Kind chess_piece_kind(Chess_Piece p) {
+  return (Chess_Kind) (p & 0x7);
+}
+
+CHESS_DEF int chess_piece_black(Chess_Piece p) {
+  return (p & CHESS_PIECE_BLACK) != 0;
+}
+
+CHESS_DEF int chess_piece_from_char(char c, Chess_Piece *p) {
   if(c == '_') {
-    *p = (Chess_Piece) { .kind = CHESS_KIND_NONE };
-    return;
+    *p = CHESS_PIECE_NONE;
+    return 1;
   }
-  
+
+  int black;
   if('A' <= c && c <= 'Z') {
     c += ' ';
-    p->black = 1; // black
+    black = 1; // black
   } else {
     
-    p->black = 0; // white
+    black = 0; // white
   }
 
   switch(c) {
   case 'r':
-    p->kind = CHESS_KIND_ROOK;
+    *p = CHESS_PIECE(CHESS_KIND_ROOK, black);
     break;
   case 'n':
-    p->kind = CHESS_KIND_KNIGHT;
+    *p = CHESS_PIECE(CHESS_KIND_KNIGHT, black);
     break;
   case 'b':
-    p->kind = CHESS_KIND_BISHOP;
+    *p = CHESS_PIECE(CHESS_KIND_BISHOP, black);
     break;
   case 'q':
-    p->kind = CHESS_KIND_QUEEN;
+    *p = CHESS_PIECE(CHESS_KIND_QUEEN, black);
     break;
   case 'k':
-    p->kind = CHESS_KIND_KING;
+    *p = CHESS_PIECE(CHESS_KIND_KING, black);
     break;
   case 'p':
-    p->kind = CHESS_KIND_PAWN;
+    *p = CHESS_PIECE(CHESS_KIND_PAWN, black);
     break;
   default:
-    fprintf(stderr, "ERROR: Unknown char '%c' in char_from_piece\n", c);
-    fflush(stderr);
-    exit(1);
+    return 0;
   }
+  return 1;
 }	
 
-CHESS_DEF int chess_move_eq(Chess_Move *a, Chess_Move *b) {
-  return
-    a->from == b->from &&
-    a->to == b->to;    
+CHESS_DEF int chess_move_from(Chess_Move m) {
+  return m & 0x3f;
+}
+
+CHESS_DEF int chess_move_to(Chess_Move m) {
+  return (m >> 6) & 0x3f;
+}
+
+CHESS_DEF int chess_move_flags(Chess_Move m) {
+  return m >> 12;
+}
+
+CHESS_DEF Chess_Kind chess_move_promotion(Chess_Move m) {
+  int flags = chess_move_flags(m);
+  if(!(flags & CHESS_MOVE_FLAG_PROMOTION)) {
+    return CHESS_KIND_NONE;
+  }
+  return CHESS_KIND_KNIGHT + (flags & 0x3);
 }
 
 CHESS_DEF int chess_move_from_cstr(char *cstr, Chess_Move *move) {
 
   int x, y;
+  int from, to;
+  int flags = 0;
   
   if(!cstr) return 0;
   if(*cstr < 'a' || 'h' < *cstr) return 0;
@@ -156,7 +850,7 @@ CHESS_DEF int chess_move_from_cstr(char *cstr, Chess_Move *move) {
   if(*cstr < '1' || '8' < *cstr) return 0;
   y = (CHESS_N - 1) - (*cstr - '1');
   cstr++;
-  move->from = y * CHESS_N + x;
+  from = y * CHESS_N + x;
 
   if(!cstr) return 0;
   if(*cstr != ' ') return 0;
@@ -171,49 +865,95 @@ CHESS_DEF int chess_move_from_cstr(char *cstr, Chess_Move *move) {
   if(*cstr < '1' || '8' < *cstr) return 0;
   y = (CHESS_N - 1) - (*cstr - '1');
   cstr++;
-  move->to = y * CHESS_N + x;
+  to = y * CHESS_N + x;
+
+  // optionally the kind to promote to, like "e7 e8n"
+  switch(*cstr) {
+  case 'n':
+    flags = CHESS_MOVE_PROMOTION(CHESS_KIND_KNIGHT);
+    cstr++;
+    break;
+  case 'b':
+    flags = CHESS_MOVE_PROMOTION(CHESS_KIND_BISHOP);
+    cstr++;
+    break;
+  case 'r':
+    flags = CHESS_MOVE_PROMOTION(CHESS_KIND_ROOK);
+    cstr++;
+    break;
+  case 'q':
+    flags = CHESS_MOVE_PROMOTION(CHESS_KIND_QUEEN);
+    cstr++;
+    break;
+  }
 
   if(*cstr) return 0;
 
+  *move = CHESS_MOVE(from, to, flags);
+
   return 1;
 }
 
-// White
-static Chess_Move CHESS_MOVE_CASTLE_WHITE_RIGHT = {
-  .from = (CHESS_N-1) * CHESS_N + 4,
-  .to   = (CHESS_N-1) * CHESS_N + (CHESS_N-2)
-};
-static Chess_Move CHESS_MOVE_CASTLE_WHITE_RIGHT_rook = {
-  .from = (CHESS_N-1) * CHESS_N + (CHESS_N-1),
-  .to   = (CHESS_N-1) * CHESS_N + 5,
-};
+CHESS_DEF void chess_move_to_cstr(Chess_Move move, char *cstr) {
+  // the inverse of chess_move_from_cstr
+  int from = chess_move_from(move);
+  int to = chess_move_to(move);
+  
+  *cstr++ = 'a' + from % CHESS_N;
+  *cstr++ = '1' + (CHESS_N - 1) - from / CHESS_N;
+  *cstr++ = ' ';
+  *cstr++ = 'a' + to % CHESS_N;
+  *cstr++ = '1' + (CHESS_N - 1) - to / CHESS_N;
+
+  Chess_Kind promotion = chess_move_promotion(move);
+  if(promotion != CHESS_KIND_NONE) {
+    *cstr++ = chess_kind_char[promotion];
+  }
+  *cstr = '\0';
+}
 
-static Chess_Move CHESS_MOVE_CASTLE_WHITE_LEFT = {
-  .from = (CHESS_N-1) * CHESS_N + 4,
-  .to   = (CHESS_N-1) * CHESS_N + 2
-};
-static Chess_Move CHESS_MOVE_CASTLE_WHITE_LEFT_rook = {
-  .from = (CHESS_N-1) * CHESS_N + 0,
-  .to   = (CHESS_N-1) * CHESS_N + 3,
-};
+// White
+static const Chess_Move CHESS_MOVE_CASTLE_WHITE_RIGHT =
+  CHESS_MOVE((CHESS_N-1) * CHESS_N + 4, (CHESS_N-1) * CHESS_N + (CHESS_N-2), CHESS_MOVE_FLAG_CASTLE);
+static const Chess_Move CHESS_MOVE_CASTLE_WHITE_LEFT =
+  CHESS_MOVE((CHESS_N-1) * CHESS_N + 4, (CHESS_N-1) * CHESS_N + 2, CHESS_MOVE_FLAG_CASTLE);
 
 // Black
-static Chess_Move CHESS_MOVE_CASTLE_BLACK_RIGHT = {
-  .from = 0 * CHESS_N + 4,
-  .to   = 0 * CHESS_N + (CHESS_N-2),
-};
-static Chess_Move CHESS_MOVE_CASTLE_BLACK_RIGHT_rook = {
-  .from = 0 * CHESS_N + (CHESS_N-1),
-  .to   = 0 * CHESS_N + 5,
-};
+static const Chess_Move CHESS_MOVE_CASTLE_BLACK_RIGHT =
+  CHESS_MOVE(0 * CHESS_N + 4, 0 * CHESS_N + (CHESS_N-2), CHESS_MOVE_FLAG_CASTLE);
+static const Chess_Move CHESS_MOVE_CASTLE_BLACK_LEFT =
+  CHESS_MOVE(0 * CHESS_N + 4, 0 * CHESS_N + 2, CHESS_MOVE_FLAG_CASTLE);
+
+// The rook jumps over the castling king
+static inline void chess_castle_rook(Chess_Move king_move, int *rook_from, int *rook_to) {
+  int from = chess_move_from(king_move);
+  int to = chess_move_to(king_move);
+  if(to > from) {
+    *rook_from = to + 1;
+    *rook_to = to - 1;
+  } else {
+    *rook_from = to - 2;
+    *rook_to = to + 1;
+  }
+}
 
-static Chess_Move CHESS_MOVE_CASTLE_BLACK_LEFT = {
-  .from = 0 * CHESS_N + 4,
-  .to   = 0 * CHESS_N + 2,
-};
-static Chess_Move CHESS_MOVE_CASTLE_BLACK_LEFT_rook = {
-  .from = 0 * CHESS_N + 0,
-  .to   = 0 * CHESS_N + 3,
+static inline void chess_game_eval_add(Chess_Game *g, Chess_Piece p, int pos, int sign) {
+  // sign is 1 for a piece put on pos, -1 for one removed
+  int black = chess_piece_black(p);
+  Chess_Kind kind = chess_piece_kind(p);
+  g->eval[CHESS_EVAL_MIDDLEGAME] += sign * chess_eval_table[black][CHESS_EVAL_MIDDLEGAME][kind][pos];
+  g->eval[CHESS_EVAL_ENDGAME] += sign * chess_eval_table[black][CHESS_EVAL_ENDGAME][kind][pos];
+  g->phase += sign * chess_eval_phase[kind];
+}
+
+// The castling rights lost by a move from or to a square
+static const int chess_castling_lost[CHESS_N * CHESS_N] = {
+  [0 * CHESS_N + 0]                     = CHESS_CASTLE_BLACK_LEFT,
+  [0 * CHESS_N + 4]                     = CHESS_CASTLE_BLACK_LEFT | CHESS_CASTLE_BLACK_RIGHT,
+  [0 * CHESS_N + (CHESS_N-1)]           = CHESS_CASTLE_BLACK_RIGHT,
+  [(CHESS_N-1) * CHESS_N + 0]           = CHESS_CASTLE_WHITE_LEFT,
+  [(CHESS_N-1) * CHESS_N + 4]           = CHESS_CASTLE_WHITE_LEFT | CHESS_CASTLE_WHITE_RIGHT,
+  [(CHESS_N-1) * CHESS_N + (CHESS_N-1)] = CHESS_CASTLE_WHITE_RIGHT,
 };
 
 CHESS_DEF void chess_game_reset(Chess_Game *g) {
@@ -228,17 +968,109 @@ CHESS_DEF void chess_game_reset(Chess_Game *g) {
     "rnbqkbnr"
     ;
   
+  chess_tables_init();
+  
+  for(int k=0;k<CHESS_KIND_KING+1;k++) {
+    g->kinds[k] = 0;
+  }
+  g->colors[0] = 0;
+  g->colors[1] = 0;
+  g->key = 0;
+  g->eval[CHESS_EVAL_MIDDLEGAME] = 0;
+  g->eval[CHESS_EVAL_ENDGAME] = 0;
+  g->phase = 0;
+  
   for(int j=0;j<CHESS_N;j++) {
     for(int i=0;i<CHESS_N;i++) {
-      chess_piece_from_char(INITIAL_BOARD[j * CHESS_N + i], &g->board[j * CHESS_N + i]);
+      Chess_Piece p = CHESS_PIECE_NONE;
+      chess_piece_from_char(INITIAL_BOARD[j * CHESS_N + i], &p);
+      g->board[j * CHESS_N + i] = CHESS_PIECE_NONE;
+      chess_game_put_piece(g, j * CHESS_N + i, p);
     }
   }
   g->blacks_turn = 0;
+  g->en_passant = -1;
+  g->castling = CHESS_CASTLE_ALL;
+  g->halfmove = 0;
+  g->fullmove = 1;
+  g->key ^= chess_zobrist_castling[g->castling];
 }
 
 CHESS_DEF void chess_game_default(Chess_Game *g) {
+  // expects a fresh game, call chess_game_free before reusing one
   chess_game_reset(g);
+  g->more_history = NULL;
+  g->more_undo = NULL;
+  g->more_cap = 0;
   g->history_len = 0;
+  g->targets = NULL;
+}
+
+CHESS_DEF void chess_game_free(Chess_Game *g) {
+  if(g->more_history) CHESS_FREE(g->more_history);
+  if(g->more_undo) CHESS_FREE(g->more_undo);
+  if(g->targets) CHESS_FREE(g->targets);
+  g->more_history = NULL;
+  g->more_undo = NULL;
+  g->more_cap = 0;
+  g->targets = NULL;
+}
+
+CHESS_DEF int chess_game_copy(Chess_Game *dst, Chess_Game *src) {
+  // dst must be fresh or freed
+  *dst = *src;
+  dst->more_history = NULL;
+  dst->more_undo = NULL;
+  dst->more_cap = 0;
+  dst->targets = NULL;
+
+  if(src->history_len > CHESS_HISTORY_CAP) {
+    if(!chess_game_reserve(dst, src->history_len)) {
+      return 0;
+    }
+    int n = src->history_len - CHESS_HISTORY_CAP;
+    for(int i=0;i<n;i++) {
+      dst->more_history[i] = src->more_history[i];
+      dst->more_undo[i] = src->more_undo[i];
+    }
+  }
+
+  return 1;
+}
+
+CHESS_DEF int chess_game_reserve(Chess_Game *g, int history_len) {
+  int cap = history_len - CHESS_HISTORY_CAP;
+  if(cap <= g->more_cap) {
+    return 1;
+  }
+
+  // grow geometrically, so pushing a move is amortized O(1) and
+  // unmaking never gives storage back
+  int new_cap = g->more_cap ? g->more_cap : CHESS_HISTORY_CAP + 1;
+  while(new_cap < cap) new_cap *= 2;
+  
+  Chess_Move *more_history = CHESS_REALLOC(g->more_history, new_cap * sizeof(Chess_Move));
+  if(!more_history) {
+    return 0;
+  }
+  g->more_history = more_history;
+  
+  Chess_Undo *more_undo = CHESS_REALLOC(g->more_undo, new_cap * sizeof(Chess_Undo));
+  if(!more_undo) {
+    return 0;
+  }
+  g->more_undo = more_undo;
+  g->more_cap = new_cap;
+  
+  return 1;
+}
+
+CHESS_DEF Chess_Move chess_game_history_at(Chess_Game *g, int i) {
+  CHESS_ASSERT(0 <= i && i < g->history_len);
+  if(i < CHESS_HISTORY_CAP) {
+    return g->history[i];
+  }
+  return g->more_history[i - CHESS_HISTORY_CAP];
 }
 
 CHESS_DEF void chess_game_dump(Chess_Game *g) {
@@ -249,9 +1081,9 @@ CHESS_DEF void chess_game_dump(Chess_Game *g) {
       }
       
       Chess_Piece piece = g->board[j * CHESS_N + i];
-      char c = chess_kind_char[piece.kind];
+      char c = chess_kind_char[chess_piece_kind(piece)];
 
-      if(piece.black) {
+      if(chess_piece_black(piece)) {
 	c -= ' ';
       }
       
@@ -264,350 +1096,803 @@ CHESS_DEF void chess_game_dump(Chess_Game *g) {
   fflush(stdout);
 }
 
-CHESS_DEF int chess_game_over(Chess_Game *g, int *white_or_black_won) {
-  if(chess_game_available_moves(g) > 0) {
+static inline int chess_fen_number(const char **fen, int *n) {
+  // at most 6 digits, so the value cannot overflow
+  const char *c = *fen;
+  int value = 0;
+  int len = 0;
+  while('0' <= *c && *c <= '9' && len < 6) {
+    value = value * 10 + (*c++ - '0');
+    len++;
+  }
+  if(len == 0) {
     return 0;
   }
-  *white_or_black_won = g->blacks_turn;
+  *fen = c;
+  *n = value;
   return 1;
+}
 
+static inline void chess_game_clear(Chess_Game *g) {
+  // an empty board without history, storage is kept
+  for(int k=0;k<CHESS_KIND_KING+1;k++) {
+    g->kinds[k] = 0;
+  }
+  g->colors[0] = 0;
+  g->colors[1] = 0;
+  g->kings[0] = -1;
+  g->kings[1] = -1;
+  g->eval[CHESS_EVAL_MIDDLEGAME] = 0;
+  g->eval[CHESS_EVAL_ENDGAME] = 0;
+  g->phase = 0;
+  for(int pos=0;pos<CHESS_N * CHESS_N;pos++) {
+    g->board[pos] = CHESS_PIECE_NONE;
+  }
+  g->history_len = 0;
 }
 
-CHESS_DEF int chess_game_available_moves(Chess_Game *g) {
-  int moves = 0;
-  
-  for(int k=0;k<CHESS_N*CHESS_N;k++) {
-    Chess_Piece p = g->board[k];
-    if(p.kind == CHESS_KIND_NONE) {
+CHESS_DEF int chess_game_from_fen(Chess_Game *g, const char *fen) {
+  // g must be set up by chess_game_default. The history is cleared,
+  // but its storage kept, so loading does not allocate. FEN writes
+  // white in uppercase, chess.h black. The move counters are optional.
+  // On failure, the position is unspecified until the next load
+  chess_tables_init();
+  chess_game_clear(g);
+
+  int pos = 0;
+  int file = 0;
+  for(;*fen && *fen != ' ';fen++) {
+    char c = *fen;
+    if(c == '/') {
+      if(file != CHESS_N) {
+	return 0;
+      }
+      file = 0;
       continue;
-    }
-      
-    if(p.black != g->blacks_turn) {
+    } else if('1' <= c && c <= '8') {
+      file += c - '0';
+      pos += c - '0';
+      if(file > CHESS_N) {
+	return 0;
+      }
       continue;
     }
-    
-    for(int l=0;l<CHESS_N*CHESS_N;l++) {
 
-      Chess_Move move = { .from = k, .to = l };
-      if(!chess_game_validate_move(g, &move)) {
-	continue;
-      }
-
-      chess_game_perform_move(g, &move);      
-      if(!chess_game_is_check(g)) {
-	moves++;
-      }
-      chess_game_rewind(g, g->history_len - 1);
-      
+    int black = 0;
+    if('a' <= c && c <= 'z') {
+      black = 1;
+      c -= ' ';
     }
-    
+    Chess_Kind kind;
+    switch(c) {
+    case 'P': kind = CHESS_KIND_PAWN; break;
+    case 'N': kind = CHESS_KIND_KNIGHT; break;
+    case 'B': kind = CHESS_KIND_BISHOP; break;
+    case 'R': kind = CHESS_KIND_ROOK; break;
+    case 'Q': kind = CHESS_KIND_QUEEN; break;
+    case 'K': kind = CHESS_KIND_KING; break;
+    default: return 0;
+    }
+    if(file >= CHESS_N || pos >= CHESS_N * CHESS_N) {
+      return 0;
+    }
+    if(kind == CHESS_KIND_KING && g->kings[black] >= 0) {
+      return 0;
+    }
+    chess_game_put_piece(g, pos++, CHESS_PIECE(kind, black));
+    file++;
   }
-
-  return moves;
-
-}
-
-CHESS_DEF int chess_game_validate_move(Chess_Game *g, Chess_Move *m) {
-  // source and destination cannot be equal
-  if(m->from == m->to) {
+  if(pos != CHESS_N * CHESS_N || file != CHESS_N ||
+     g->kings[0] < 0 || g->kings[1] < 0 || *fen++ != ' ') {
     return 0;
   }
 
-  int src_x = m->from % CHESS_N;
-  int src_y = m->from / CHESS_N;
-
-  int dst_x = m->to % CHESS_N;
-  int dst_y = m->to / CHESS_N;
-
-  // all moves must happen inside the board
-  if(src_x < 0 || CHESS_N <= src_x ||
-     src_y < 0 || CHESS_N <= src_y) {
+  if(*fen == 'w') {
+    g->blacks_turn = 0;
+  } else if(*fen == 'b') {
+    g->blacks_turn = 1;
+  } else {
     return 0;
   }
-
-  Chess_Piece piece = g->board[m->from];
-
-  // only pieces can move
-  if(piece.kind == CHESS_KIND_NONE) {
+  fen++;
+  if(*fen++ != ' ') {
     return 0;
   }
 
-  // only pieces from the right turn can move
-  if(piece.black != g->blacks_turn) {
-    return 0;
+  g->castling = 0;
+  if(*fen == '-') {
+    // no rights, '-' stands alone
+    fen++;
+  } else {
+    const char *rights = fen;
+    for(;*fen && *fen != ' ';fen++) {
+      switch(*fen) {
+      case 'K': g->castling |= CHESS_CASTLE_WHITE_RIGHT; break;
+      case 'Q': g->castling |= CHESS_CASTLE_WHITE_LEFT; break;
+      case 'k': g->castling |= CHESS_CASTLE_BLACK_RIGHT; break;
+      case 'q': g->castling |= CHESS_CASTLE_BLACK_LEFT; break;
+      default: return 0;
+      }
+    }
+    if(fen == rights) {
+      return 0;
+    }
   }
-
-  // pieces can not move on the same color
-  Chess_Piece dest = g->board[m->to];
-  if(dest.kind != CHESS_KIND_NONE &&
-     dest.black == piece.black) {
+  // drop rights, whose king or rook is not on its square. Castling
+  // only checks the right
+  int corners[] = {
+    (CHESS_N-1) * CHESS_N, (CHESS_N-1) * CHESS_N + (CHESS_N-1),
+    0, CHESS_N-1,
+  };
+  for(int i=0;i<4;i++) {
+    int black = i >= 2;
+    int king = black ? 4 : (CHESS_N-1) * CHESS_N + 4;
+    if(g->board[king] != CHESS_PIECE(CHESS_KIND_KING, black) ||
+       g->board[corners[i]] != CHESS_PIECE(CHESS_KIND_ROOK, black)) {
+      g->castling &= ~chess_castling_lost[corners[i]];
+    }
+  }
+  if(*fen++ != ' ') {
     return 0;
   }
 
-  int dx = dst_x - src_x;
-  int dy = dst_y - src_y;
-
-  int dx_abs;
-  if(dx < 0) {
-    dx_abs = -1 * dx;
+  g->en_passant = -1;
+  if(*fen == '-') {
+    fen++;
+  } else if('a' <= fen[0] && fen[0] <= 'h' && '1' <= fen[1] && fen[1] <= '8') {
+    int ep = ((CHESS_N - 1) - (fen[1] - '1')) * CHESS_N + (fen[0] - 'a');
+    // the square a pawn of the other side just skipped: behind its
+    // pawn, on rank 6 or 3, with the square it came from empty.
+    // Anything else would let the capture remove the wrong piece
+    int forward = g->blacks_turn ? CHESS_N : -CHESS_N;
+    int rank = g->blacks_turn ? CHESS_N - 3 : 2;
+    Chess_Bitboard occupied = chess_game_occupied(g);
+    if(ep / CHESS_N != rank ||
+       (occupied & (CHESS_BIT(ep) | CHESS_BIT(ep + forward))) ||
+       g->board[ep - forward] != CHESS_PIECE(CHESS_KIND_PAWN, !g->blacks_turn)) {
+      return 0;
+    }
+    // like chess_game_perform_move, only if a pawn can capture
+    if(chess_pawn_table[!g->blacks_turn][ep] &
+       g->kinds[CHESS_KIND_PAWN] & g->colors[g->blacks_turn]) {
+      g->en_passant = ep;
+    }
+    fen += 2;
   } else {
-    dx_abs = dx;
+    return 0;
   }
 
-  int dy_abs;
-  if(dy < 0) {
-    dy_abs = -1 * dy;
-  } else {
-    dy_abs = dy;
-  }
+  g->halfmove = 0;
+  g->fullmove = 1;
+  if(*fen == ' ' && '0' <= fen[1] && fen[1] <= '9') {
+    fen++;
+    if(!chess_fen_number(&fen, &g->halfmove) || *fen++ != ' ' ||
+       !chess_fen_number(&fen, &g->fullmove)) {
+      return 0;
+    }
+    if(g->fullmove < 1) g->fullmove = 1;
+  }
+  // only trailing whitespace may follow
+  while(*fen == ' ' || *fen == '\t' || *fen == '\r' || *fen == '\n') {
+    fen++;
+  }
+  if(*fen != '\0') {
+    return 0;
+  }
+
+  // no legal position has pawns on the first or last rank, or lets
+  // the side to move capture the king
+  if((g->kinds[CHESS_KIND_PAWN] & (CHESS_ROW(0) | CHESS_ROW(CHESS_N - 1))) ||
+     chess_game_is_attacked(g, g->kings[!g->blacks_turn], g->blacks_turn)) {
+    return 0;
+  }
+
+  g->key = chess_game_compute_key(g);
+  return 1;
+}
+
+static inline char *chess_fen_write_number(char *cstr, int n) {
+  char digits[16];
+  int len = 0;
+  do {
+    digits[len++] = (char) ('0' + n % 10);
+    n /= 10;
+  } while(n > 0 && len < (int) sizeof(digits));
+  while(len > 0) {
+    *cstr++ = digits[--len];
+  }
+  return cstr;
+}
+
+CHESS_DEF void chess_game_to_fen(Chess_Game *g, char *cstr) {
+  // cstr must hold CHESS_FEN_CAP chars
+  for(int j=0;j<CHESS_N;j++) {
+    int empty = 0;
+    for(int i=0;i<CHESS_N;i++) {
+      Chess_Piece p = g->board[j * CHESS_N + i];
+      if(chess_piece_kind(p) == CHESS_KIND_NONE) {
+	empty++;
+	continue;
+      }
+      if(empty > 0) {
+	*cstr++ = (char) ('0' + empty);
+	empty = 0;
+      }
+      char c = chess_kind_char[chess_piece_kind(p)];
+      if(!chess_piece_black(p)) {
+	c -= ' ';
+      }
+      *cstr++ = c;
+    }
+    if(empty > 0) {
+      *cstr++ = (char) ('0' + empty);
+    }
+    if(j < CHESS_N - 1) {
+      *cstr++ = '/';
+    }
+  }
+
+  *cstr++ = ' ';
+  *cstr++ = g->blacks_turn ? 'b' : 'w';
 
-  int dx_n;
-  if(dx > 0) {
-    dx_n = 1;
-  } else if(dx < 0) {
-    dx_n = -1;
+  *cstr++ = ' ';
+  if(g->castling == 0) {
+    *cstr++ = '-';
   } else {
-    dx_n = 0;
+    if(g->castling & CHESS_CASTLE_WHITE_RIGHT) *cstr++ = 'K';
+    if(g->castling & CHESS_CASTLE_WHITE_LEFT)  *cstr++ = 'Q';
+    if(g->castling & CHESS_CASTLE_BLACK_RIGHT) *cstr++ = 'k';
+    if(g->castling & CHESS_CASTLE_BLACK_LEFT)  *cstr++ = 'q';
   }
 
-  int dy_n;
-  if(dy > 0) {
-    dy_n = 1;
-  } else if(dy < 0) {
-    dy_n = -1;
+  *cstr++ = ' ';
+  if(g->en_passant >= 0) {
+    *cstr++ = (char) ('a' + g->en_passant % CHESS_N);
+    *cstr++ = (char) ('1' + (CHESS_N - 1) - g->en_passant / CHESS_N);
   } else {
-    dy_n = 0;
+    *cstr++ = '-';
   }
 
-  switch(piece.kind) {
+  *cstr++ = ' ';
+  cstr = chess_fen_write_number(cstr, g->halfmove);
+  *cstr++ = ' ';
+  cstr = chess_fen_write_number(cstr, g->fullmove);
+  *cstr = '\0';
+}
 
-  case CHESS_KIND_NONE:
-    return 0; // unreachable
+CHESS_DEF int chess_game_over(Chess_Game *g, int *white_or_black_won) {
+  if(chess_game_has_legal_move(g)) {
+    return 0;
+  }
+  *white_or_black_won = g->blacks_turn;
+  return 1;
+
+}
+
+CHESS_DEF int chess_game_available_moves(Chess_Game *g) {
+  Chess_Move moves[CHESS_MOVES_CAP];
+  return chess_game_generate_legal_moves(g, moves, CHESS_MOVES_CAP);
+}
+
+#define chess_moves_push(out, len, cap, f, t, flags) do{	\
+    CHESS_ASSERT((len) < (cap));				\
+    (out)[(len)++] = CHESS_MOVE((f), (t), (flags));		\
+  }while(0)
+
+#define chess_moves_push_pawn(out, len, cap, f, t) do{		\
+    if(CHESS_BIT(t) & (CHESS_ROW(0) | CHESS_ROW(CHESS_N - 1))) {	\
+      chess_moves_push(out, len, cap, f, t, CHESS_MOVE_PROMOTION(CHESS_KIND_QUEEN)); \
+      chess_moves_push(out, len, cap, f, t, CHESS_MOVE_PROMOTION(CHESS_KIND_KNIGHT)); \
+      chess_moves_push(out, len, cap, f, t, CHESS_MOVE_PROMOTION(CHESS_KIND_ROOK)); \
+      chess_moves_push(out, len, cap, f, t, CHESS_MOVE_PROMOTION(CHESS_KIND_BISHOP)); \
+    } else {								\
+      chess_moves_push(out, len, cap, f, t, 0);				\
+    }									\
+  }while(0)
+
+CHESS_DEF int chess_game_generate(Chess_Game *g, int which, Chess_Move *out, int cap) {
+  int len = 0;
+
+  int black = g->blacks_turn;
+  Chess_Bitboard own = g->colors[black];
+  Chess_Bitboard enemy = g->colors[1 - black];
+  Chess_Bitboard occupied = own | enemy;
+  Chess_Bitboard empty = ~occupied;
+
+  // pawns, all at once
+  Chess_Bitboard pawns = g->kinds[CHESS_KIND_PAWN] & own;
+  Chess_Bitboard single, twice, left, right;
+  int forward;
+  if(black) {
+    forward = CHESS_N;
+    single = (pawns << CHESS_N) & empty;
+    twice  = ((single & CHESS_ROW(2)) << CHESS_N) & empty;
+    left   = (pawns << (CHESS_N - 1)) & ~CHESS_FILE_H & enemy;
+    right  = (pawns << (CHESS_N + 1)) & ~CHESS_FILE_A & enemy;
+  } else {
+    forward = -CHESS_N;
+    single = (pawns >> CHESS_N) & empty;
+    twice  = ((single & CHESS_ROW(CHESS_N - 3)) >> CHESS_N) & empty;
+    left   = (pawns >> (CHESS_N + 1)) & ~CHESS_FILE_H & enemy;
+    right  = (pawns >> (CHESS_N - 1)) & ~CHESS_FILE_A & enemy;
+  }
+  // promotions count as captures
+  Chess_Bitboard last = CHESS_ROW(0) | CHESS_ROW(CHESS_N - 1);
+  if(!(which & CHESS_GENERATE_CAPTURES)) {
+    single &= ~last;
+    left = right = 0;
+  }
+  if(!(which & CHESS_GENERATE_QUIETS)) {
+    single &= last;
+    twice = 0;
+  }
+  while(single) {
+    int to = chess_bitboard_pop(&single);
+    chess_moves_push_pawn(out, len, cap, to - forward, to);
+  }
+  while(twice) {
+    int to = chess_bitboard_pop(&twice);
+    chess_moves_push(out, len, cap, to - 2 * forward, to, 0);
+  }
+  while(left) {
+    int to = chess_bitboard_pop(&left);
+    chess_moves_push_pawn(out, len, cap, to - forward + 1, to);
+  }
+  while(right) {
+    int to = chess_bitboard_pop(&right);
+    chess_moves_push_pawn(out, len, cap, to - forward - 1, to);
+  }
+  if(g->en_passant >= 0 && (which & CHESS_GENERATE_CAPTURES)) {
+    Chess_Bitboard capturers =
+      chess_pawn_table[!black][g->en_passant] & pawns;
+    while(capturers) {
+      int from = chess_bitboard_pop(&capturers);
+      chess_moves_push(out, len, cap, from, g->en_passant, CHESS_MOVE_FLAG_EN_PASSANT);
+    }
+  }
+
+  // pieces, one at a time
+  Chess_Bitboard allowed = 0;
+  if(which & CHESS_GENERATE_CAPTURES) allowed |= enemy;
+  if(which & CHESS_GENERATE_QUIETS) allowed |= empty;
+  Chess_Bitboard pieces = own & ~pawns;
+  while(pieces) {
+    int from = chess_bitboard_pop(&pieces);
+
+    Chess_Bitboard targets;
+    switch(chess_piece_kind(g->board[from])) {
+    case CHESS_KIND_KNIGHT:
+      targets = chess_knight_table[from];
+      break;
+    case CHESS_KIND_BISHOP:
+      targets = chess_bitboard_bishop_attacks(from, occupied);
+      break;
+    case CHESS_KIND_ROOK:
+      targets = chess_bitboard_rook_attacks(from, occupied);
+      break;
+    case CHESS_KIND_QUEEN:
+      targets = chess_bitboard_queen_attacks(from, occupied);
+      break;
+    case CHESS_KIND_KING:
+      targets = chess_king_table[from];
+      break;
+    default:
+      targets = 0; // unreachable
+      break;
+    }
     
-  case CHESS_KIND_PAWN:
-    // TODO: implement 'En passant'
+    targets &= allowed;
+    while(targets) {
+      int to = chess_bitboard_pop(&targets);
+      chess_moves_push(out, len, cap, from, to, 0);
+    }
+  }
 
-    // pawns must move vertically
-    if(dy == 0) { 
-      return 0;
+  if(!(which & CHESS_GENERATE_QUIETS)) {
+    return len;
+  }
+
+  // castling
+  Chess_Move castles[2] = { CHESS_MOVE_CASTLE_WHITE_LEFT, CHESS_MOVE_CASTLE_WHITE_RIGHT };
+  if(black) {
+    castles[0] = CHESS_MOVE_CASTLE_BLACK_LEFT;
+    castles[1] = CHESS_MOVE_CASTLE_BLACK_RIGHT;
+  }
+  for(int i=0;i<2;i++) {
+    if(chess_game_can_castle(g, castles[i])) {
+      CHESS_ASSERT(len < cap);
+      out[len++] = castles[i];
     }
+  }
 
-    // pawns must move towards the enemy
-    if(piece.black) {
-      if(dy < 0) { // up
-	return 0;
-      } else {     // down
-	
+  return len;
+}
+
+CHESS_DEF int chess_game_generate_moves(Chess_Game *g, Chess_Move *out, int cap) {
+  return chess_game_generate(g, CHESS_GENERATE_ALL, out, cap);
+}
+
+CHESS_DEF int chess_game_generate_legal(Chess_Game *g, int which, Chess_Move *out, int cap) {
+  int len = chess_game_generate(g, which, out, cap);
+  return chess_game_filter_legal(g, out, len);
+}
+
+CHESS_DEF int chess_game_generate_legal_moves(Chess_Game *g, Chess_Move *out, int cap) {
+  return chess_game_generate_legal(g, CHESS_GENERATE_ALL, out, cap);
+}
+
+CHESS_DEF int chess_game_filter_legal(Chess_Game *g, Chess_Move *moves, int len) {
+  // keeps the generated moves, that do not leave the king in check
+  int king_pos = g->kings[g->blacks_turn];
+
+  Chess_Bitboard checkers = chess_game_checkers(g);
+  Chess_Bitboard pinned = chess_game_pinned(g);
+  
+  // outside of check, everything may be targeted
+  Chess_Bitboard evasions = ~((Chess_Bitboard) 0);
+  if(checkers) {
+    if(checkers & (checkers - 1)) {
+      // double check, only the king can move
+      evasions = 0;
+    } else {
+      // capture the checker or block
+      evasions = checkers | chess_bitboard_between(king_pos, chess_bitboard_first(checkers));
+    }
+  }
+
+  int legal = 0;
+  for(int i=0;i<len;i++) {
+    Chess_Move m = moves[i];
+    int from = chess_move_from(m);
+    int to = chess_move_to(m);
+
+    if(from == king_pos || chess_move_flags(m) == CHESS_MOVE_FLAG_EN_PASSANT) {
+      // the king and 'En passant' may discover attacks, so try them
+      chess_game_perform_move(g, m);
+      int check = chess_game_is_check(g);
+      chess_game_unmake(g);
+      if(check) {
+	continue;
       }
-    } else { // piece.write
-      if(dy < 0) { // up
-	
-      } else {     // down
-	return 0;
+      
+    } else {
+
+      if(!(evasions & CHESS_BIT(to))) {
+	continue;
       }
+
+      // pinned pieces can only move along the pin
+      if((pinned & CHESS_BIT(from)) &&
+	 !(chess_bitboard_line(king_pos, from) & CHESS_BIT(to))) {
+	continue;
+      }
+      
     }
-    
-    // pawns must move vertically 1 or 2 steps
-    if(dy_abs == 1) {
 
-      if(dx == 0) { // dx == 0, dy_abs == 1
+    moves[legal++] = m;
+  }
 
-	// pawns can not move, if something
-	// is in front of them
-	if(dest.kind == CHESS_KIND_NONE) {
-	  
-	} else {
-	  return 0;
-	}
-	 
-      } else { // (dx != 0) => (dx_abs > 0)
-
-	// pawns can only move vertically 1 and
-	// horizontally 1, if they capture
-	if(dx_abs == 1) {  // dy_abs == 1, dx_abs == 1
-
-	  if(dest.kind != CHESS_KIND_NONE &&
-	     dest.black != piece.black) {
-	    
-	  } else {
-	    return 0;
-	  }
-	  
-	} else {
-	  return 0;
-	}
-	
+  return legal;
+}
+
+CHESS_DEF int chess_game_is_legal(Chess_Game *g, Chess_Move m) {
+  // for moves from elsewhere, like a hash table. The flags have to
+  // match the position, as if m was generated. No move sets the
+  // flag bit between 'En passant' and promotion
+  if(chess_move_flags(m) & 0x4) {
+    return 0;
+  }
+  if(chess_game_complete_move(g, m) != m || !chess_game_validate_move(g, m)) {
+    return 0;
+  }
+  return chess_game_filter_legal(g, &m, 1);
+}
+
+CHESS_DEF int chess_game_has_legal_move(Chess_Game *g) {
+  // like chess_game_generate_legal_moves, but stops at the first move
+  int black = g->blacks_turn;
+  Chess_Bitboard own = g->colors[black];
+  Chess_Bitboard enemy = g->colors[1 - black];
+  Chess_Bitboard occupied = own | enemy;
+  int king_pos = g->kings[black];
+
+  // the king first, it can answer every check. Castling needs the
+  // step next to the king to be legal, so it never matters here
+  Chess_Bitboard targets = chess_king_table[king_pos] & ~own;
+  while(targets) {
+    int to = chess_bitboard_pop(&targets);
+    if(!chess_game_attackers(g, to, 1 - black, occupied & ~CHESS_BIT(king_pos))) {
+      return 1;
+    }
+  }
+
+  Chess_Bitboard checkers = chess_game_checkers(g);
+  if(checkers & (checkers - 1)) {
+    // double check, only the king can move
+    return 0;
+  }
+  Chess_Bitboard evasions = ~((Chess_Bitboard) 0);
+  if(checkers) {
+    evasions = checkers | chess_bitboard_between(king_pos, chess_bitboard_first(checkers));
+  }
+  Chess_Bitboard pinned = chess_game_pinned(g);
+
+  // the other pieces, all targets at once
+  Chess_Bitboard pieces = own & ~CHESS_BIT(king_pos);
+  while(pieces) {
+    int from = chess_bitboard_pop(&pieces);
+    Chess_Bitboard b = CHESS_BIT(from);
+
+    switch(chess_piece_kind(g->board[from])) {
+    case CHESS_KIND_PAWN: {
+      Chess_Bitboard single, twice;
+      if(black) {
+	single = (b << CHESS_N) & ~occupied;
+	twice  = ((single & CHESS_ROW(2)) << CHESS_N) & ~occupied;
+      } else {
+	single = (b >> CHESS_N) & ~occupied;
+	twice  = ((single & CHESS_ROW(CHESS_N - 3)) >> CHESS_N) & ~occupied;
       }
+      targets = single | twice | (chess_pawn_table[black][from] & enemy);
+    } break;
+    case CHESS_KIND_KNIGHT:
+      targets = chess_knight_table[from];
+      break;
+    case CHESS_KIND_BISHOP:
+      targets = chess_bitboard_bishop_attacks(from, occupied);
+      break;
+    case CHESS_KIND_ROOK:
+      targets = chess_bitboard_rook_attacks(from, occupied);
+      break;
+    case CHESS_KIND_QUEEN:
+      targets = chess_bitboard_queen_attacks(from, occupied);
+      break;
+    default:
+      targets = 0; // unreachable
+      break;
+    }
 
-    } else if(dy_abs == 2) {
+    targets &= ~own & evasions;
+    if(pinned & b) {
+      targets &= chess_bitboard_line(king_pos, from);
+    }
+    if(targets) {
+      return 1;
+    }
+  }
 
-      // pawns can only move vertically 2 steps,
-      // if horizontal step is 0 and they are in
-      // there initial position and there ist nothing
-      if(dx != 0) {
-	return 0;
+  // 'En passant' may discover attacks, so try it
+  if(g->en_passant >= 0) {
+    Chess_Bitboard capturers = chess_pawn_table[!black][g->en_passant] &
+      g->kinds[CHESS_KIND_PAWN] & own;
+    while(capturers) {
+      int from = chess_bitboard_pop(&capturers);
+      chess_game_perform_move(g, CHESS_MOVE(from, g->en_passant, CHESS_MOVE_FLAG_EN_PASSANT));
+      int check = chess_game_is_check(g);
+      chess_game_unmake(g);
+      if(!check) {
+	return 1;
       }
+    }
+  }
+
+  return 0;
+}
+
+CHESS_DEF Chess_Status chess_game_status(Chess_Game *g) {
+  if(chess_game_has_legal_move(g)) {
+    return CHESS_STATUS_PLAYING;
+  }
+  return chess_game_checkers(g) ? CHESS_STATUS_CHECKMATE : CHESS_STATUS_STALEMATE;
+}
+
+CHESS_DEF Chess_Bitboard chess_game_legal_targets(Chess_Game *g, int from) {
+  // one generation fills every square, the result is kept until the
+  // position changes
+  Chess_Targets *t = g->targets;
+  if(!t) {
+    t = CHESS_REALLOC(NULL, sizeof(Chess_Targets));
+    if(!t) {
+      return 0;
+    }
+    t->key = ~g->key;
+    g->targets = t;
+  }
+
+  if(t->key != g->key) {
+    for(int pos=0;pos<CHESS_N * CHESS_N;pos++) {
+      t->to[pos] = 0;
+    }
+    Chess_Move moves[CHESS_MOVES_CAP];
+    int len = chess_game_generate_legal_moves(g, moves, CHESS_MOVES_CAP);
+    for(int i=0;i<len;i++) {
+      t->to[chess_move_from(moves[i])] |= CHESS_BIT(chess_move_to(moves[i]));
+    }
+    t->key = g->key;
+  }
 
-      if(dest.kind != CHESS_KIND_NONE) {
+  return t->to[from];
+}
+
+CHESS_DEF Chess_Move chess_game_complete_move(Chess_Game *g, Chess_Move m) {
+  // fills in the flags, that follow from the position. Only the kind
+  // of a promotion is taken from m, it defaults to the queen
+  int from = chess_move_from(m);
+  int to = chess_move_to(m);
+  int promotion = chess_move_flags(m);
+  if(!(promotion & CHESS_MOVE_FLAG_PROMOTION)) {
+    promotion = CHESS_MOVE_PROMOTION(CHESS_KIND_QUEEN);
+  }
+  int flags = 0;
+
+  Chess_Piece piece = g->board[from];
+  if(chess_piece_kind(piece) == CHESS_KIND_KING) {
+    int dx = to % CHESS_N - from % CHESS_N;
+    if(dx == 2 || dx == -2) {
+      flags |= CHESS_MOVE_FLAG_CASTLE;
+    }
+    
+  } else if(chess_piece_kind(piece) == CHESS_KIND_PAWN) {
+    if(to == g->en_passant) {
+      flags |= CHESS_MOVE_FLAG_EN_PASSANT;
+    }
+    if(CHESS_BIT(to) & (CHESS_ROW(0) | CHESS_ROW(CHESS_N - 1))) {
+      flags = promotion;
+    }
+    
+  }
+
+  return CHESS_MOVE(from, to, flags);
+}
+
+CHESS_DEF int chess_game_validate_move(Chess_Game *g, Chess_Move m) {
+  int from = chess_move_from(m);
+  int to = chess_move_to(m);
+  int flags = chess_move_flags(m);
+  
+  // source and destination cannot be equal
+  if(from == to) {
+    return 0;
+  }
+
+  Chess_Piece piece = g->board[from];
+
+  // only pieces can move
+  if(chess_piece_kind(piece) == CHESS_KIND_NONE) {
+    return 0;
+  }
+
+  // only pieces from the right turn can move
+  int black = chess_piece_black(piece);
+  if(black != g->blacks_turn) {
+    return 0;
+  }
+
+  // pieces can not move on the same color
+  if(g->colors[black] & CHESS_BIT(to)) {
+    return 0;
+  }
+
+  // only pawns and kings make special moves
+  if(flags &&
+     chess_piece_kind(piece) != CHESS_KIND_PAWN &&
+     chess_piece_kind(piece) != CHESS_KIND_KING) {
+    return 0;
+  }
+
+  Chess_Bitboard occupied = chess_game_occupied(g);
+  int step = chess_dir_table[from][to];
+  int diagonal =
+    step == CHESS_N + 1 || step == -(CHESS_N + 1) ||
+    step == CHESS_N - 1 || step == -(CHESS_N - 1);
+
+  switch(chess_piece_kind(piece)) {
+
+  case CHESS_KIND_NONE:
+    return 0; // unreachable
+
+  case CHESS_KIND_PAWN: {
+    int forward = black ? CHESS_N : -CHESS_N;
+    
+    // pawns must promote, when they reach the other side
+    if(CHESS_BIT(to) & (CHESS_ROW(0) | CHESS_ROW(CHESS_N - 1))) {
+      if(!(flags & CHESS_MOVE_FLAG_PROMOTION)) {
 	return 0;
       }
+      flags = 0;
+    }
 
-      if(piece.black) {
-	if(src_y == 1) {
-	  
-	} else {
+    if(chess_pawn_table[black][from] & CHESS_BIT(to)) {
+      // pawns move diagonally, if they capture. Either what is
+      // there or 'En passant'
+      if(occupied & CHESS_BIT(to)) {
+	if(flags) {
 	  return 0;
 	}
-	
-      } else { // piece.white
-	if(src_y == (CHESS_N-2)) {
-	  
-	} else {
+      } else if(to == g->en_passant) {
+	if(flags != CHESS_MOVE_FLAG_EN_PASSANT) {
 	  return 0;
 	}
-	
+      } else {
+	return 0;
+      }
+      
+    } else if(to == from + forward) {
+      // pawns can not move, if something is in front of them
+      if(flags || (occupied & CHESS_BIT(to))) {
+	return 0;
       }
       
-    } else { // dy_abs > 2
+    } else if(to == from + 2 * forward) {
+      // pawns can move 2 steps from their initial row, if nothing is
+      // in the way
+      int row = black ? 1 : CHESS_N - 2;
+      if(flags ||
+	 from / CHESS_N != row ||
+	 (occupied & (CHESS_BIT(to) | CHESS_BIT(from + forward)))) {
+	return 0;
+      }
+      
+    } else {
       return 0;
     }
     
-    break;
+  } break;
 
   case CHESS_KIND_KNIGHT:
 
-    // knights can either move: 
-    // horizontally 2 and vertically 1 or
-    // horizontally 1 and vertically 2
-    if(dx_abs == 2 && dy_abs == 1) {
-      
-    } else if(dx_abs == 1 && dy_abs == 2) {
-      
-    } else {
+    if(!(chess_knight_table[from] & CHESS_BIT(to))) {
       return 0;
     }
 
     break;
 
   case CHESS_KIND_BISHOP:
-
-    if(!chess_game_validate_move_bishop(g,
-					src_x,
-					src_y,
-					dst_x,
-					dst_y,
-					dx_abs,
-					dy_abs,
-					dx_n,
-					dy_n)) {
-      return 0;
-    }
-    
-    break;
-
   case CHESS_KIND_ROOK:
+  case CHESS_KIND_QUEEN:
 
-    if(!chess_game_validate_move_rook(g,
-				      src_x,
-				      src_y,
-				      dst_x,
-				      dst_y,
-				      dx_abs,
-				      dy_abs,
-				      dx_n,
-				      dy_n)) {
+    // sliders move along their lines, until something is in the way
+    if(step == 0 ||
+       (chess_piece_kind(piece) == CHESS_KIND_BISHOP && !diagonal) ||
+       (chess_piece_kind(piece) == CHESS_KIND_ROOK && diagonal)) {
       return 0;
     }
-
-    break;
-
-  case CHESS_KIND_QUEEN:
-
-    ; // -pedantic
-    int good = 0;
-    if(chess_game_validate_move_bishop(g,
-				       src_x,
-				       src_y,
-				       dst_x,
-				       dst_y,
-				       dx_abs,
-				       dy_abs,
-				       dx_n,
-				       dy_n)) {
-      good = 1;
-    }
-
-    if(!good && 
-       chess_game_validate_move_rook(g,
-				     src_x,
-				     src_y,
-				     dst_x,
-				     dst_y,
-				     dx_abs,
-				     dy_abs,
-				     dx_n,
-				     dy_n)) {
-      good = 1;
-    }
-
-    if(!good) {
+    if(chess_between_table[from][to] & occupied) {
       return 0;
     }
-
+    
     break;
 
   case CHESS_KIND_KING:
     
-    if(dx_abs <= 1 && dy_abs <= 1) {
+    if(chess_king_table[from] & CHESS_BIT(to)) {
       // kings can move 1 step vertically and horizontally
       // in every direction
 
+      if(flags) {
+	return 0;
+      }
       
     } else {
       // Kings may 'castle'
 
-      if(!chess_game_check_path(g,
-				src_x,
-				src_y,
-				dst_x,
-				dst_y,
-				dx_n,
-				dy_n)) {
-	return 0;
-      }
-
-      // TODO: Must the path be unattacked by the opponent?
-
-      int king_pos;
-      int rook_pos;
-      if(piece.black) {
+      if(black) {
 
-	if(chess_move_eq(m, &CHESS_MOVE_CASTLE_BLACK_LEFT)) {
-	  king_pos = CHESS_MOVE_CASTLE_BLACK_LEFT.from;
-	  rook_pos = CHESS_MOVE_CASTLE_BLACK_LEFT_rook.from;
-	} else if(chess_move_eq(m, &CHESS_MOVE_CASTLE_BLACK_RIGHT)) {
-	  king_pos = CHESS_MOVE_CASTLE_BLACK_RIGHT.from;
-	  rook_pos = CHESS_MOVE_CASTLE_BLACK_RIGHT_rook.from;
-	} else {
+	if(m != CHESS_MOVE_CASTLE_BLACK_LEFT &&
+	   m != CHESS_MOVE_CASTLE_BLACK_RIGHT) {
 	  return 0;
 	}
 	
       } else { // piece.white
 	
-	if(chess_move_eq(m, &CHESS_MOVE_CASTLE_WHITE_LEFT)) {
-	  king_pos = CHESS_MOVE_CASTLE_WHITE_LEFT.from;
-	  rook_pos = CHESS_MOVE_CASTLE_WHITE_LEFT_rook.from;
-	} else if(chess_move_eq(m, &CHESS_MOVE_CASTLE_WHITE_RIGHT)) {
-	  king_pos = CHESS_MOVE_CASTLE_WHITE_RIGHT.from;
-	  rook_pos = CHESS_MOVE_CASTLE_WHITE_RIGHT_rook.from;
-	} else {
+	if(m != CHESS_MOVE_CASTLE_WHITE_LEFT &&
+	   m != CHESS_MOVE_CASTLE_WHITE_RIGHT) {
 	  return 0;
 	}
 	
       }
 
-      if(chess_game_piece_has_moved(g, king_pos) ||
-	 chess_game_piece_has_moved(g, rook_pos)) {
+      if(!chess_game_can_castle(g, m)) {
 	return 0;
       }
       
@@ -621,219 +1906,436 @@ CHESS_DEF int chess_game_validate_move(Chess_Game *g, Chess_Move *m) {
     
 }
 
-CHESS_DEF void chess_game_perform_move_impl(Chess_Game *g, Chess_Move *m) {
-  g->board[m->to] = g->board[m->from];
-  g->board[m->from] = (Chess_Piece) { .kind = CHESS_KIND_NONE };  
+CHESS_DEF void chess_game_put_piece(Chess_Game *g, int pos, Chess_Piece p) {
+  CHESS_ASSERT(chess_piece_kind(g->board[pos]) == CHESS_KIND_NONE);
+  if(chess_piece_kind(p) == CHESS_KIND_NONE) {
+    return;
+  }
+
+  g->board[pos] = p;
+  g->kinds[chess_piece_kind(p)] |= CHESS_BIT(pos);
+  g->colors[chess_piece_black(p)] |= CHESS_BIT(pos);
+  g->key ^= chess_zobrist_pieces[chess_piece_black(p)][chess_piece_kind(p)][pos];
+  chess_game_eval_add(g, p, pos, 1);
+  if(chess_piece_kind(p) == CHESS_KIND_KING) {
+    g->kings[chess_piece_black(p)] = pos;
+  }
 }
 
-CHESS_DEF void chess_game_perform_move(Chess_Game *g, Chess_Move *m) {
-  chess_game_perform_move_impl(g, m);
+CHESS_DEF Chess_Piece chess_game_remove_piece(Chess_Game *g, int pos) {
+  Chess_Piece p = g->board[pos];
+  if(chess_piece_kind(p) == CHESS_KIND_NONE) {
+    return p;
+  }
+
+  g->board[pos] = CHESS_PIECE_NONE;
+  g->kinds[chess_piece_kind(p)] &= ~CHESS_BIT(pos);
+  g->colors[chess_piece_black(p)] &= ~CHESS_BIT(pos);
+  g->key ^= chess_zobrist_pieces[chess_piece_black(p)][chess_piece_kind(p)][pos];
+  chess_game_eval_add(g, p, pos, -1);
+  return p;
+}
+
+CHESS_DEF Chess_Bitboard chess_game_occupied(Chess_Game *g) {
+  return g->colors[0] | g->colors[1];
+}
+
+CHESS_DEF void chess_game_perform_move_impl(Chess_Game *g, int from, int to) {
+  chess_game_remove_piece(g, to);
+  chess_game_put_piece(g, to, chess_game_remove_piece(g, from));
+}
+
+CHESS_DEF int chess_game_perform_move(Chess_Game *g, Chess_Move m) {
+  Chess_Undo *undo;
+  if(g->history_len < CHESS_HISTORY_CAP) {
+    g->history[g->history_len] = m;
+    undo = &g->undo[g->history_len];
+  } else {
+    if(!chess_game_reserve(g, g->history_len + 1)) {
+      return 0;
+    }
+    g->more_history[g->history_len - CHESS_HISTORY_CAP] = m;
+    undo = &g->more_undo[g->history_len - CHESS_HISTORY_CAP];
+  }
+  g->history_len++;
+
+  int from = chess_move_from(m);
+  int to = chess_move_to(m);
+  int flags = chess_move_flags(m);
   
-  if(g->history_len == CHESS_HISTORY_CAP) {
-    fprintf(stderr, "ERROR: history-overflow\n");
-    fflush(stderr);
-    exit(1);
+  undo->en_passant = g->en_passant;
+  undo->castling = g->castling;
+  undo->halfmove = g->halfmove;
+  undo->key = g->key;
+
+  g->key ^= chess_zobrist_castling[g->castling];
+  g->castling &= ~(chess_castling_lost[from] | chess_castling_lost[to]);
+  g->key ^= chess_zobrist_castling[g->castling];
+
+  Chess_Piece piece = g->board[from];
+  int forward = chess_piece_black(piece) ? CHESS_N : -CHESS_N;
+  if(g->en_passant >= 0) {
+    g->key ^= chess_zobrist_en_passant[g->en_passant % CHESS_N];
+  }
+  g->en_passant = -1;
+  if(chess_piece_kind(piece) == CHESS_KIND_PAWN && to - from == 2 * forward) {
+    // only remember the square, if an enemy pawn can capture there.
+    // Otherwise the key would tell equal positions apart
+    int pos = from + forward;
+    if(chess_pawn_table[chess_piece_black(piece)][pos] &
+       g->kinds[CHESS_KIND_PAWN] & g->colors[1 - chess_piece_black(piece)]) {
+      g->en_passant = pos;
+      g->key ^= chess_zobrist_en_passant[pos % CHESS_N];
+    }
+  }
+
+  if(flags == CHESS_MOVE_FLAG_EN_PASSANT) {
+    // 'En passant' captures the pawn behind the destination
+    undo->captured = chess_game_remove_piece(g, to - forward);
+  } else {
+    undo->captured = chess_game_remove_piece(g, to);
   }
-  g->history[g->history_len++] = *m;
 
-  Chess_Move *rook_move = NULL;
-  if(chess_move_eq(m, &CHESS_MOVE_CASTLE_WHITE_LEFT)) {
-    rook_move = &CHESS_MOVE_CASTLE_WHITE_LEFT_rook;
-  } else if(chess_move_eq(m, &CHESS_MOVE_CASTLE_WHITE_RIGHT)) {
-    rook_move = &CHESS_MOVE_CASTLE_WHITE_RIGHT_rook;
-  } else if(chess_move_eq(m, &CHESS_MOVE_CASTLE_BLACK_LEFT)) {
-    rook_move = &CHESS_MOVE_CASTLE_BLACK_LEFT_rook;
-  } else if(chess_move_eq(m, &CHESS_MOVE_CASTLE_BLACK_RIGHT)) {
-    rook_move = &CHESS_MOVE_CASTLE_BLACK_RIGHT_rook;
+  g->halfmove++;
+  if(chess_piece_kind(piece) == CHESS_KIND_PAWN ||
+     chess_piece_kind(undo->captured) != CHESS_KIND_NONE) {
+    g->halfmove = 0;
+  }
+  if(chess_piece_black(piece)) {
+    g->fullmove++;
+  }
+
+  if(flags & CHESS_MOVE_FLAG_PROMOTION) {
+    chess_game_remove_piece(g, from);
+    piece = CHESS_PIECE(chess_move_promotion(m), chess_piece_black(piece));
+    chess_game_put_piece(g, to, piece);
+  } else {
+    chess_game_perform_move_impl(g, from, to);
   }
 
-  if(rook_move) {
-    chess_game_perform_move_impl(g, rook_move);
+  if(flags == CHESS_MOVE_FLAG_CASTLE) {
+    int rook_from, rook_to;
+    chess_castle_rook(m, &rook_from, &rook_to);
+    chess_game_perform_move_impl(g, rook_from, rook_to);
   }
 
   g->blacks_turn = 1 - g->blacks_turn;
+  g->key ^= chess_zobrist_black;
+
+  return 1;
+}
+
+CHESS_DEF void chess_game_unmake(Chess_Game *g) {
+  CHESS_ASSERT(g->history_len > 0);
+
+  g->history_len--;
+  Chess_Move m;
+  Chess_Undo *undo;
+  if(g->history_len < CHESS_HISTORY_CAP) {
+    m = g->history[g->history_len];
+    undo = &g->undo[g->history_len];
+  } else {
+    m = g->more_history[g->history_len - CHESS_HISTORY_CAP];
+    undo = &g->more_undo[g->history_len - CHESS_HISTORY_CAP];
+  }
+
+  int from = chess_move_from(m);
+  int to = chess_move_to(m);
+  int flags = chess_move_flags(m);
+
+  if(flags == CHESS_MOVE_FLAG_CASTLE) {
+    int rook_from, rook_to;
+    chess_castle_rook(m, &rook_from, &rook_to);
+    chess_game_perform_move_impl(g, rook_to, rook_from);
+  }
+
+  Chess_Piece piece = chess_game_remove_piece(g, to);
+  if(flags & CHESS_MOVE_FLAG_PROMOTION) {
+    piece = CHESS_PIECE(CHESS_KIND_PAWN, chess_piece_black(piece));
+  }
+  chess_game_put_piece(g, from, piece);
   
+  if(flags == CHESS_MOVE_FLAG_EN_PASSANT) {
+    chess_game_put_piece(g, to - (chess_piece_black(piece) ? CHESS_N : -CHESS_N), undo->captured);
+  } else {
+    chess_game_put_piece(g, to, undo->captured);
+  }
+  g->en_passant = undo->en_passant;
+  g->castling = undo->castling;
+  g->halfmove = undo->halfmove;
+  g->key = undo->key;
+  if(chess_piece_black(piece)) {
+    g->fullmove--;
+  }
+
+  g->blacks_turn = 1 - g->blacks_turn;
 }
 
-CHESS_DEF int chess_game_is_check(Chess_Game *g) {
-  int king_pos = chess_game_king_position(g);
+CHESS_DEF int chess_game_is_attacked(Chess_Game *g, int pos, int by_black) {
+  Chess_Bitboard attackers = g->colors[by_black];
 
-  for(int k=0;k<CHESS_N*CHESS_N;k++) {
-    Chess_Piece p = g->board[k];
-    if(p.kind == CHESS_KIND_NONE) {
-      continue;
-    }
-      
-    if(p.black != g->blacks_turn) {
-      continue;
-    }
+  // a pawn attacks pos, if a pawn of the other color would attack
+  // the pawn from pos
+  if(chess_pawn_table[!by_black][pos] & g->kinds[CHESS_KIND_PAWN] & attackers) {
+    return 1;
+  }
+  if(chess_knight_table[pos] & g->kinds[CHESS_KIND_KNIGHT] & attackers) {
+    return 1;
+  }
+  if(chess_king_table[pos] & g->kinds[CHESS_KIND_KING] & attackers) {
+    return 1;
+  }
 
-    Chess_Move move = { .from = k, .to = king_pos };
-    if(chess_game_validate_move(g, &move)) {      
-      return 1;
-    }
-      
+  Chess_Bitboard queens = g->kinds[CHESS_KIND_QUEEN];
+  Chess_Bitboard occupied = chess_game_occupied(g);
+  if(chess_bitboard_bishop_attacks(pos, occupied) &
+     (g->kinds[CHESS_KIND_BISHOP] | queens) & attackers) {
+    return 1;
+  }
+  if(chess_bitboard_rook_attacks(pos, occupied) &
+     (g->kinds[CHESS_KIND_ROOK] | queens) & attackers) {
+    return 1;
   }
 
   return 0;
+}
+
+CHESS_DEF Chess_Bitboard chess_game_attackers(Chess_Game *g, int pos, int by_black, Chess_Bitboard occupied) {
+  Chess_Bitboard queens = g->kinds[CHESS_KIND_QUEEN];
 
+  Chess_Bitboard attackers =
+    (chess_pawn_table[!by_black][pos] & g->kinds[CHESS_KIND_PAWN]) |
+    (chess_knight_table[pos] & g->kinds[CHESS_KIND_KNIGHT]) |
+    (chess_king_table[pos] & g->kinds[CHESS_KIND_KING]) |
+    (chess_bitboard_bishop_attacks(pos, occupied) & (g->kinds[CHESS_KIND_BISHOP] | queens)) |
+    (chess_bitboard_rook_attacks(pos, occupied) & (g->kinds[CHESS_KIND_ROOK] | queens));
+
+  return attackers & g->colors[by_black] & occupied;
 }
 
-CHESS_DEF void chess_game_rewind(Chess_Game *g, int rewind_to) {
-  CHESS_ASSERT(0 <= rewind_to && rewind_to < g->history_len);
-  
-  chess_game_default(g);
-  
-  for(int i=0;i<rewind_to;i++) {    
-    CHESS_ASSERT(chess_game_move(g, &g->history[i]));
+CHESS_DEF Chess_Bitboard chess_game_checkers(Chess_Game *g) {
+  // the pieces attacking the king of the player, whose turn it is
+  int black = g->blacks_turn;
+  return chess_game_attackers(g, g->kings[black], 1 - black, chess_game_occupied(g));
+}
+
+CHESS_DEF Chess_Bitboard chess_game_pinned(Chess_Game *g) {
+  // the pieces of the player, whose turn it is, that shield their king
+  // from an enemy slider
+  int black = g->blacks_turn;
+  Chess_Bitboard own = g->colors[black];
+  Chess_Bitboard enemy = g->colors[1 - black];
+  int king_pos = g->kings[black];
+
+  Chess_Bitboard queens = g->kinds[CHESS_KIND_QUEEN];
+  Chess_Bitboard snipers = enemy &
+    ((chess_bitboard_bishop_attacks(king_pos, enemy) & (g->kinds[CHESS_KIND_BISHOP] | queens)) |
+     (chess_bitboard_rook_attacks(king_pos, enemy) & (g->kinds[CHESS_KIND_ROOK] | queens)));
+
+  Chess_Bitboard occupied = own | enemy;
+  Chess_Bitboard pinned = 0;
+  while(snipers) {
+    int pos = chess_bitboard_pop(&snipers);
+    Chess_Bitboard blockers = chess_bitboard_between(king_pos, pos) & occupied;
+    if(blockers && !(blockers & (blockers - 1))) {
+      pinned |= blockers & own;
+    }
   }
 
+  return pinned;
 }
 
-CHESS_DEF int chess_game_validate_move_bishop(Chess_Game *g,
-					      int src_x,
-					      int src_y,
-					      int dst_x,
-					      int dst_y,
-					      int dx_abs,
-					      int dy_abs,
-					      int dx_n,				    
-					      int dy_n) {
-  // bishops can only move
-  // diagonally =>
-  //     dx_abs == dy_abs
-  if(dx_abs != dy_abs) {
-    return 0;
+CHESS_DEF Chess_Key chess_game_compute_key(Chess_Game *g) {
+  // from scratch, g->key is kept up to date incrementally
+  Chess_Key key = 0;
+
+  Chess_Bitboard occupied = chess_game_occupied(g);
+  while(occupied) {
+    int pos = chess_bitboard_pop(&occupied);
+    Chess_Piece p = g->board[pos];
+    key ^= chess_zobrist_pieces[chess_piece_black(p)][chess_piece_kind(p)][pos];
   }
 
-  if(!chess_game_check_path(g,
-			    src_x,
-			    src_y,
-			    dst_x,
-			    dst_y,
-			    dx_n,
-			    dy_n)) {
-    return 0;
+  key ^= chess_zobrist_castling[g->castling];
+  if(g->en_passant >= 0) {
+    key ^= chess_zobrist_en_passant[g->en_passant % CHESS_N];
+  }
+  if(g->blacks_turn) {
+    key ^= chess_zobrist_black;
   }
 
-  return 1;
+  return key;
+}
 
+CHESS_DEF int chess_game_is_check(Chess_Game *g) {
+  int king_pos = chess_game_king_position(g);
+  return chess_game_is_attacked(g, king_pos, g->blacks_turn);
 }
 
-CHESS_DEF int chess_game_validate_move_rook(Chess_Game *g,
-					    int src_x,
-					    int src_y,
-					    int dst_x,
-					    int dst_y,
-					    int dx_abs,
-					    int dy_abs,
-					    int dx_n,
-					    int dy_n) {
-  // rooks can only move
-  // diametrally =>
-  //     (dx_abs > 0 && dy_abs == 0) || (dx_abs == 0 && dy_abs > 0)
-  if(dx_abs > 0) {
+CHESS_DEF void chess_game_rewind(Chess_Game *g, int rewind_to) {
+  CHESS_ASSERT(0 <= rewind_to && rewind_to <= g->history_len);
+  
+  while(g->history_len > rewind_to) {
+    chess_game_unmake(g);
+  }
+
+}
 
-    if(dy_abs > 0) { // dx_abs > 0, dy_abs > 0
-      return 0;
-    } else {         // dx_abs > 0, dy_abs == 0
-	
-    }
-      
-  } else { // (0 <= dx_abs && dx_abs <= 0) => dx_abs == 0
+CHESS_DEF int chess_game_can_castle(Chess_Game *g, Chess_Move king_move) {
+  int king_from = chess_move_from(king_move);
+  int rook_from, rook_to;
+  chess_castle_rook(king_move, &rook_from, &rook_to);
+  
+  // the right is lost, as soon as king or rook leave their square
+  int right = chess_castling_lost[rook_from];
+  if(!(g->castling & right)) {
+    return 0;
+  }
 
-    if(dy_abs > 0) { // dx_abs == 0, dy_abs > 0
-	
-    } else {         // dx_abs == 0, dy_abs == 0
-      return 0;
-    }
-      
+  // every square between king and rook must be empty
+  int lo = king_from < rook_from ? king_from : rook_from;
+  int hi = king_from < rook_from ? rook_from : king_from;
+  Chess_Bitboard between = (CHESS_BIT(hi) - 1) & ~(CHESS_BIT(lo + 1) - 1);
+  if(chess_game_occupied(g) & between) {
+    return 0;
   }
 
-  if(!chess_game_check_path(g,
-			    src_x,
-			    src_y,
-			    dst_x,
-			    dst_y,
-			    dx_n,
-			    dy_n)) {
+  // the king can neither castle out of, nor through check. Landing in
+  // check is caught like for every other move
+  if(chess_game_is_attacked(g, king_from, 1 - g->blacks_turn) ||
+     chess_game_is_attacked(g, rook_to, 1 - g->blacks_turn)) {
     return 0;
   }
 
   return 1;
-  
 }
 
-CHESS_DEF int chess_game_check_path(Chess_Game *g,
-				    int src_x,
-				    int src_y,
-				    int dst_x,
-				    int dst_y,
-				    int dx_n,
-				    int dy_n) {
-  int x = src_x + dx_n;
-  int y = src_y + dy_n;
+CHESS_DEF int chess_game_king_position(Chess_Game *g) {
+  // the king of the player, who just moved
+  return g->kings[1 - g->blacks_turn];
 
-  while(x != dst_x || y != dst_y) {
-    if(g->board[y * CHESS_N + x].kind != CHESS_KIND_NONE) {
-      return 0;
-    }
+}
 
-    x += dx_n;
-    y += dy_n;
+CHESS_DEF int chess_game_move(Chess_Game *g, Chess_Move *m) {
+  // a bare 'from'-'to' move gets its flags here
+  *m = chess_game_complete_move(g, *m);
+  
+  if(!chess_game_validate_move(g, *m)) {
+    return 0;
+  }
+  
+  if(!chess_game_perform_move(g, *m)) {
+    return 0;
   }
 
+  if(chess_game_is_check(g)) {
+    chess_game_unmake(g);
+    return 0;
+  }
+  
   return 1;
 
 }
 
-CHESS_DEF int chess_game_piece_has_moved(Chess_Game *g, int pos) {
-  for(int i=0;i<g->history_len;i++) {
-    Chess_Move move = g->history[i];
+CHESS_DEF void chess_snapshot_take(Chess_Snapshot *s, Chess_Game *g) {
+  for(int pos=0;pos<CHESS_N * CHESS_N;pos++) {
+    s->board[pos] = g->board[pos];
+  }
+  s->en_passant = (signed char) g->en_passant;
+  s->castling = (unsigned char) g->castling;
+  s->blacks_turn = (unsigned char) g->blacks_turn;
+  s->halfmove = (unsigned short) (g->halfmove < 0xffff ? g->halfmove : 0xffff);
+  s->fullmove = g->fullmove;
+}
 
-    if(move.from == pos) {
-      return 1;
-    }
+CHESS_DEF void chess_snapshot_load(Chess_Snapshot *s, Chess_Game *g) {
+  // g must be set up by chess_game_default, like for chess_game_from_fen
+  chess_game_clear(g);
+  for(int pos=0;pos<CHESS_N * CHESS_N;pos++) {
+    chess_game_put_piece(g, pos, s->board[pos]);
   }
+  g->en_passant = s->en_passant;
+  g->castling = s->castling;
+  g->blacks_turn = s->blacks_turn;
+  g->halfmove = s->halfmove;
+  g->fullmove = s->fullmove;
+  g->key = chess_game_compute_key(g);
+}
 
-  return 0;
+CHESS_DEF int chess_timeline_init(Chess_Timeline *t, Chess_Game *start, int interval) {
+  // starts at the current position of start, which may have a history
+  t->interval = interval > 0 ? interval : CHESS_TIMELINE_DEFAULT_INTERVAL;
+  t->moves = NULL;
+  t->moves_len = 0;
+  t->moves_cap = 0;
+  t->snapshots = CHESS_REALLOC(NULL, sizeof(Chess_Snapshot));
+  if(!t->snapshots) {
+    return 0;
+  }
+  chess_snapshot_take(&t->snapshots[0], start);
+  t->snapshots_len = 1;
+  t->snapshots_cap = 1;
+  return 1;
+}
 
+CHESS_DEF void chess_timeline_free(Chess_Timeline *t) {
+  if(t->moves) CHESS_FREE(t->moves);
+  if(t->snapshots) CHESS_FREE(t->snapshots);
+  t->moves = NULL;
+  t->moves_len = 0;
+  t->moves_cap = 0;
+  t->snapshots = NULL;
+  t->snapshots_len = 0;
+  t->snapshots_cap = 0;
 }
 
-CHESS_DEF int chess_game_king_position(Chess_Game *g) {
-  int king_pos = -1;
-  for(int k=0;k<CHESS_N*CHESS_N;k++) {
-    Chess_Piece p = g->board[k];
-    if(p.kind != CHESS_KIND_KING) {
-      continue;
-    }
-      
-    if(p.black == g->blacks_turn) {
-      continue;
+CHESS_DEF int chess_timeline_push(Chess_Timeline *t, Chess_Game *g, Chess_Move m) {
+  // m was just performed on g, which is now at ply t->moves_len + 1
+  if(t->moves_len >= t->moves_cap) {
+    int new_cap = t->moves_cap ? t->moves_cap * 2 : 64;
+    Chess_Move *moves = CHESS_REALLOC(t->moves, new_cap * sizeof(Chess_Move));
+    if(!moves) {
+      return 0;
     }
-
-    king_pos = k;
+    t->moves = moves;
+    t->moves_cap = new_cap;
   }
-  CHESS_ASSERT(0 <= king_pos && king_pos < CHESS_N*CHESS_N);
 
-  return king_pos;
+  if((t->moves_len + 1) % t->interval == 0) {
+    if(t->snapshots_len >= t->snapshots_cap) {
+      int new_cap = t->snapshots_cap * 2;
+      Chess_Snapshot *snapshots = CHESS_REALLOC(t->snapshots, new_cap * sizeof(Chess_Snapshot));
+      if(!snapshots) {
+	return 0;
+      }
+      t->snapshots = snapshots;
+      t->snapshots_cap = new_cap;
+    }
+    chess_snapshot_take(&t->snapshots[t->snapshots_len++], g);
+  }
 
+  t->moves[t->moves_len++] = m;
+  return 1;
 }
 
-CHESS_DEF int chess_game_move(Chess_Game *g, Chess_Move *m) {
-  if(!chess_game_validate_move(g, m)) {
-    return 0;
-  }
-  
-  chess_game_perform_move(g, m); 
+CHESS_DEF void chess_timeline_truncate(Chess_Timeline *t, int ply) {
+  // forgets the moves after ply, like after taking moves back
+  CHESS_ASSERT(0 <= ply && ply <= t->moves_len);
+  t->moves_len = ply;
+  t->snapshots_len = ply / t->interval + 1;
+}
 
-  if(chess_game_is_check(g)) {
-    chess_game_rewind(g, g->history_len - 1);
-    return 0;
+CHESS_DEF int chess_timeline_seek(Chess_Timeline *t, Chess_Game *g, int ply) {
+  // g ends up at ply, with only the replayed moves as history
+  CHESS_ASSERT(0 <= ply && ply <= t->moves_len);
+  int i = ply / t->interval;
+  chess_snapshot_load(&t->snapshots[i], g);
+  for(int k=i * t->interval;k<ply;k++) {
+    if(!chess_game_perform_move(g, t->moves[k])) {
+      return 0;
+    }
   }
-  
   return 1;
-
 }
 
 #endif // CHESS_IMPLEMENTATION
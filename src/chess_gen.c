@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// computes the tables at runtime, to print them
+#define CHESS_NO_GENERATED_TABLES
+#define CHESS_IMPLEMENTATION
+#include "chess.h"
+
+#define N (CHESS_N * CHESS_N)
+
+void print_values(Chess_Bitboard *values, int len, const char *indent) {
+  for(int i=0;i<len;i++) {
+    if(i % 4 == 0) {
+      printf("\n%s", indent);
+    }
+    printf(" 0x%016llxULL,", values[i]);
+  }
+  printf("\n");
+}
+
+void print_bitboards(const char *decl, Chess_Bitboard *table, int rows, int cols) {
+  // one brace per row, if the table has rows
+  printf("%s = {", decl);
+  if(rows == 1) {
+    print_values(table, cols, "  ");
+  } else {
+    printf("\n");
+    for(int j=0;j<rows;j++) {
+      printf("  {");
+      print_values(&table[j * cols], cols, "   ");
+      printf("  },\n");
+    }
+  }
+  printf("};\n\n");
+}
+
+void print_dirs(const char *decl, signed char *table, int rows, int cols) {
+  printf("%s = {\n", decl);
+  for(int j=0;j<rows;j++) {
+    printf("  {");
+    for(int i=0;i<cols;i++) {
+      if(i % 16 == 0) {
+	printf("\n   ");
+      }
+      printf(" %3d,", table[j * cols + i]);
+    }
+    printf("\n  },\n");
+  }
+  printf("};\n\n");
+}
+
+int main() {
+
+  chess_tables_init();
+
+  printf("// Generated by src/chess_gen.c, do not edit\n\n");
+
+  print_bitboards("static const Chess_Bitboard chess_knight_table[CHESS_N * CHESS_N]",
+		  chess_knight_table, 1, N);
+  print_bitboards("static const Chess_Bitboard chess_king_table[CHESS_N * CHESS_N]",
+		  chess_king_table, 1, N);
+  print_bitboards("static const Chess_Bitboard chess_pawn_table[2][CHESS_N * CHESS_N]",
+		  &chess_pawn_table[0][0], 2, N);
+  print_bitboards("static const Chess_Bitboard chess_between_table[CHESS_N * CHESS_N][CHESS_N * CHESS_N]",
+		  &chess_between_table[0][0], N, N);
+  print_bitboards("static const Chess_Bitboard chess_line_table[CHESS_N * CHESS_N][CHESS_N * CHESS_N]",
+		  &chess_line_table[0][0], N, N);
+  print_dirs("static const signed char chess_dir_table[CHESS_N * CHESS_N][CHESS_N * CHESS_N]",
+	     &chess_dir_table[0][0], N, N);
+
+  printf("static const Chess_Key chess_zobrist_pieces[2][CHESS_KIND_KING + 1][CHESS_N * CHESS_N] = {\n");
+  for(int c=0;c<2;c++) {
+    printf("  {\n");
+    for(int k=0;k<CHESS_KIND_KING+1;k++) {
+      printf("    {");
+      print_values(chess_zobrist_pieces[c][k], N, "     ");
+      printf("    },\n");
+    }
+    printf("  },\n");
+  }
+  printf("};\n\n");
+  print_bitboards("static const Chess_Key chess_zobrist_castling[CHESS_CASTLE_ALL + 1]",
+		  chess_zobrist_castling, 1, CHESS_CASTLE_ALL + 1);
+  print_bitboards("static const Chess_Key chess_zobrist_en_passant[CHESS_N]",
+		  chess_zobrist_en_passant, 1, CHESS_N);
+  printf("static const Chess_Key chess_zobrist_black = 0x%016llxULL;\n", chess_zobrist_black);
+
+  return 0;
+}
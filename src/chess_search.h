@@ -0,0 +1,758 @@
+#ifndef CHESS_SEARCH_H
+#define CHESS_SEARCH_H
+
+// Needs chess.h and chess_thread.h, included before
+
+#ifndef CHESS_SEARCH_DEF
+#  define CHESS_SEARCH_DEF static inline
+#endif // CHESS_SEARCH_DEF
+
+#include <stdint.h>
+#include <time.h>
+
+// Scores are in centipawns, from the view of the player to move. A
+// mate in n plies scores CHESS_SEARCH_MATE - n
+#define CHESS_SEARCH_MATE 32000
+#define CHESS_SEARCH_INF  32767
+#define CHESS_SEARCH_MAX_DEPTH 64
+
+// A limit of 0 means no limit. Without any, the search stops at
+// CHESS_SEARCH_MAX_DEPTH. nodes is checked every 1024 nodes
+typedef struct {
+  int depth;
+  double seconds;
+  unsigned long long nodes;
+  int threads; // searching the same root, sharing the table. 0 means 1
+} Chess_Search_Limits;
+
+typedef struct {
+  Chess_Move best;
+  int score;
+  int depth;  // of the last complete iteration
+  unsigned long long nodes;
+  double seconds;
+} Chess_Search_Result;
+
+#define CHESS_SEARCH_BOUND_UPPER 0x1 // the score is at most this
+#define CHESS_SEARCH_BOUND_LOWER 0x2 // the score is at least this
+#define CHESS_SEARCH_BOUND_EXACT (CHESS_SEARCH_BOUND_UPPER | CHESS_SEARCH_BOUND_LOWER)
+
+// A transposition table entry. data packs the move (bits 0..15), the
+// score (16..31), the depth (32..39), the bound (40..41) and the age of
+// the search (42..49). check is key ^ data, so an entry written half by
+// one thread and half by another fails the check and reads as a miss,
+// without locks
+typedef struct {
+  volatile unsigned long long check;
+  volatile unsigned long long data;
+} Chess_Search_Entry;
+
+// One cache line
+#define CHESS_SEARCH_BUCKET_LEN 4
+typedef struct {
+  Chess_Search_Entry entries[CHESS_SEARCH_BUCKET_LEN];
+} Chess_Search_Bucket;
+
+// Fixed size, shared by every search and thread using it
+typedef struct {
+  Chess_Search_Bucket *buckets; // aligned to a cache line
+  void *memory;
+  unsigned long long mask;
+  int age; // of the latest search, entries of older ones are replaced first
+} Chess_Search_Table;
+
+CHESS_SEARCH_DEF int chess_search_table_init(Chess_Search_Table *t, unsigned long long megabytes);
+CHESS_SEARCH_DEF void chess_search_table_free(Chess_Search_Table *t);
+CHESS_SEARCH_DEF void chess_search_table_clear(Chess_Search_Table *t);
+CHESS_SEARCH_DEF int chess_search_table_probe(Chess_Search_Table *t, Chess_Key key,
+					      Chess_Move *move, int *score, int *depth, int *bound);
+CHESS_SEARCH_DEF void chess_search_table_store(Chess_Search_Table *t, Chess_Key key,
+					       Chess_Move move, int score, int depth, int bound);
+
+// Searches the position of g with iterative deepening. g is used to
+// make and unmake moves, and is back at its position afterwards. table
+// may be NULL. Returns 0, if the player to move has no legal move
+CHESS_SEARCH_DEF int chess_search(Chess_Game *g, Chess_Search_Table *table,
+				  Chess_Search_Limits limits, Chess_Search_Result *result);
+
+CHESS_SEARCH_DEF int chess_search_evaluate(Chess_Game *g);
+
+#ifdef CHESS_SEARCH_IMPLEMENTATION
+
+// What the threads of one search share
+typedef struct {
+  Chess_Search_Table *table;
+  Chess_Search_Limits limits;
+  int max_depth;
+  double start;
+  volatile long long nodes; // of all threads, added every 1024 nodes
+  volatile long long stop;
+} Chess_Search_Shared;
+
+// One thread of a search (Lazy SMP). Every thread runs iterative
+// deepening on its own copy of the game, they only meet in the table
+typedef struct {
+  Chess_Search_Shared *shared;
+  Chess_Game *game;
+  Chess_Game copy; // the game of a helper thread
+  int id;          // 0 for the thread, that started the search
+  int ply;         // below the root
+  unsigned long long nodes;
+  int stopped;
+
+  // of the last complete iteration
+  Chess_Move best;
+  int score;
+  int depth;
+
+  // move ordering, learnt from the cutoffs of this thread
+  Chess_Move killers[CHESS_SEARCH_MAX_DEPTH][2];             // quiet moves by ply
+  Chess_Move counter[CHESS_N * CHESS_N][CHESS_N * CHESS_N];   // answers by from and to of the last move
+  int history[2][CHESS_N * CHESS_N][CHESS_N * CHESS_N];       // quiet moves by color, from and to
+} Chess_Search;
+
+// History scores stay within +-CHESS_SEARCH_HISTORY_MAX
+#define CHESS_SEARCH_HISTORY_MAX 16384
+
+// The moves of a node come out stage by stage. Every stage is only
+// entered, once the ones before did not cut off
+typedef enum {
+  CHESS_SEARCH_STAGE_TABLE = 0,
+  CHESS_SEARCH_STAGE_CAPTURES_GENERATE,
+  CHESS_SEARCH_STAGE_CAPTURES,
+  CHESS_SEARCH_STAGE_KILLERS,
+  CHESS_SEARCH_STAGE_COUNTER,
+  CHESS_SEARCH_STAGE_QUIETS_GENERATE,
+  CHESS_SEARCH_STAGE_QUIETS,
+  CHESS_SEARCH_STAGE_DONE,
+} Chess_Search_Stage;
+
+typedef struct {
+  Chess_Search_Stage stage;
+  int quiets; // 0 stops after the captures
+  Chess_Move table_move;
+  Chess_Move killers[2];
+  Chess_Move counter;
+
+  // of the current generate stage
+  Chess_Move moves[CHESS_MOVES_CAP];
+  int scores[CHESS_MOVES_CAP];
+  int len;
+  int next;
+} Chess_Search_Picker;
+
+CHESS_SEARCH_DEF int chess_search_table_init(Chess_Search_Table *t, unsigned long long megabytes) {
+  // the largest power of two of buckets, that fits
+  unsigned long long len = 1;
+  while(len * 2 * sizeof(Chess_Search_Bucket) <= megabytes * 1024 * 1024) {
+    len *= 2;
+  }
+
+  t->memory = CHESS_REALLOC(NULL, len * sizeof(Chess_Search_Bucket) + 63);
+  if(!t->memory) {
+    return 0;
+  }
+  t->buckets = (Chess_Search_Bucket *) (((uintptr_t) t->memory + 63) & ~(uintptr_t) 63);
+  t->mask = len - 1;
+  t->age = 0;
+  chess_search_table_clear(t);
+  return 1;
+}
+
+CHESS_SEARCH_DEF void chess_search_table_free(Chess_Search_Table *t) {
+  if(t->memory) CHESS_FREE(t->memory);
+  t->memory = NULL;
+  t->buckets = NULL;
+  t->mask = 0;
+}
+
+CHESS_SEARCH_DEF void chess_search_table_clear(Chess_Search_Table *t) {
+  for(unsigned long long i=0;i<=t->mask;i++) {
+    for(int k=0;k<CHESS_SEARCH_BUCKET_LEN;k++) {
+      t->buckets[i].entries[k].check = 0;
+      t->buckets[i].entries[k].data = 0;
+    }
+  }
+}
+
+// Relaxed, the check catches entries written half by another thread
+static inline unsigned long long chess_search_entry_load(volatile unsigned long long *p) {
+#ifdef _MSC_VER
+  return *p;
+#else
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+#endif // _MSC_VER
+}
+
+static inline void chess_search_entry_store(volatile unsigned long long *p, unsigned long long value) {
+#ifdef _MSC_VER
+  *p = value;
+#else
+  __atomic_store_n(p, value, __ATOMIC_RELAXED);
+#endif // _MSC_VER
+}
+
+CHESS_SEARCH_DEF int chess_search_table_probe(Chess_Search_Table *t, Chess_Key key,
+					      Chess_Move *move, int *score, int *depth, int *bound) {
+  Chess_Search_Bucket *b = &t->buckets[key & t->mask];
+  for(int k=0;k<CHESS_SEARCH_BUCKET_LEN;k++) {
+    unsigned long long data = chess_search_entry_load(&b->entries[k].data);
+    unsigned long long check = chess_search_entry_load(&b->entries[k].check);
+    if((check ^ data) != key || ((data >> 40) & 0x3) == 0) {
+      continue;
+    }
+    *move = (Chess_Move) (data & 0xffff);
+    *score = (int) ((data >> 16) & 0xffff) - 0x8000;
+    *depth = (int) ((data >> 32) & 0xff);
+    *bound = (int) ((data >> 40) & 0x3);
+    return 1;
+  }
+  return 0;
+}
+
+CHESS_SEARCH_DEF void chess_search_table_store(Chess_Search_Table *t, Chess_Key key,
+					       Chess_Move move, int score, int depth, int bound) {
+  Chess_Search_Bucket *b = &t->buckets[key & t->mask];
+  int age = t->age & 0xff;
+
+  // the entry of the same position, or the one worth the least: shallow
+  // and from an old search
+  Chess_Search_Entry *replace = NULL;
+  int replace_worth = 0;
+  for(int k=0;k<CHESS_SEARCH_BUCKET_LEN;k++) {
+    Chess_Search_Entry *e = &b->entries[k];
+    unsigned long long data = chess_search_entry_load(&e->data);
+    if((chess_search_entry_load(&e->check) ^ data) == key) {
+      // keep a deeper result of this search, unless exact
+      if(bound != CHESS_SEARCH_BOUND_EXACT &&
+	 (int) ((data >> 42) & 0xff) == age && (int) ((data >> 32) & 0xff) > depth + 2) {
+	return;
+      }
+      if(move == 0) {
+	move = (Chess_Move) (data & 0xffff);
+      }
+      replace = e;
+      break;
+    }
+
+    int worth = (int) ((data >> 32) & 0xff) - 8 * ((age - (int) ((data >> 42) & 0xff)) & 0xff);
+    if(!replace || worth < replace_worth) {
+      replace = e;
+      replace_worth = worth;
+    }
+  }
+
+  if(depth < 0) depth = 0;
+  if(depth > 0xff) depth = 0xff;
+  unsigned long long data =
+    (unsigned long long) move |
+    ((unsigned long long) (score + 0x8000) << 16) |
+    ((unsigned long long) depth << 32) |
+    ((unsigned long long) bound << 40) |
+    ((unsigned long long) age << 42);
+  chess_search_entry_store(&replace->check, key ^ data);
+  chess_search_entry_store(&replace->data, data);
+}
+
+static inline int chess_search_score_to_table(int score, int ply) {
+  // mates are stored relative to the position, not the root
+  if(score > CHESS_SEARCH_MATE - 2 * CHESS_SEARCH_MAX_DEPTH) return score + ply;
+  if(score < -CHESS_SEARCH_MATE + 2 * CHESS_SEARCH_MAX_DEPTH) return score - ply;
+  return score;
+}
+
+static inline int chess_search_score_from_table(int score, int ply) {
+  if(score > CHESS_SEARCH_MATE - 2 * CHESS_SEARCH_MAX_DEPTH) return score - ply;
+  if(score < -CHESS_SEARCH_MATE + 2 * CHESS_SEARCH_MAX_DEPTH) return score + ply;
+  return score;
+}
+
+static inline double chess_search_now(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+CHESS_SEARCH_DEF int chess_search_evaluate(Chess_Game *g) {
+  // g keeps both stages up to date, they are only blended by the
+  // material left. Promotions can push the phase past its maximum
+  int phase = g->phase < CHESS_EVAL_PHASE_MAX ? g->phase : CHESS_EVAL_PHASE_MAX;
+  int score = (g->eval[CHESS_EVAL_MIDDLEGAME] * phase +
+	       g->eval[CHESS_EVAL_ENDGAME] * (CHESS_EVAL_PHASE_MAX - phase)) / CHESS_EVAL_PHASE_MAX;
+  return g->blacks_turn ? -score : score;
+}
+
+static inline int chess_search_should_stop(Chess_Search *s) {
+  if(s->stopped) {
+    return 1;
+  }
+  if((s->nodes & 1023) != 0) {
+    return 0;
+  }
+
+  Chess_Search_Shared *shared = s->shared;
+  long long nodes = chess_atomic_add(&shared->nodes, 1024) + 1024;
+  if(s->id == 0) {
+    // only the first thread looks at the clock
+    if((shared->limits.nodes && (unsigned long long) nodes >= shared->limits.nodes) ||
+       (shared->limits.seconds > 0 && chess_search_now() - shared->start >= shared->limits.seconds)) {
+      chess_atomic_store(&shared->stop, 1);
+    }
+  }
+  s->stopped = chess_atomic_load(&shared->stop) != 0;
+  return s->stopped;
+}
+
+static inline int chess_search_is_draw(Chess_Game *g) {
+  if(g->halfmove >= 100) {
+    return 1;
+  }
+
+  // a repetition can only reach back to the last capture or pawn move
+  int end = g->history_len - g->halfmove;
+  if(end < 0) end = 0;
+  for(int i=g->history_len - 2;i>=end;i-=2) {
+    Chess_Undo *undo = i < CHESS_HISTORY_CAP
+      ? &g->undo[i]
+      : &g->more_undo[i - CHESS_HISTORY_CAP];
+    if(undo->key == g->key) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static inline int chess_search_is_quiet(Chess_Game *g, Chess_Move m) {
+  // what chess_game_generate counts as quiet
+  return g->board[chess_move_to(m)] == CHESS_PIECE_NONE &&
+    !(chess_move_flags(m) & (CHESS_MOVE_FLAG_EN_PASSANT | CHESS_MOVE_FLAG_PROMOTION));
+}
+
+static inline int chess_search_capture_order(Chess_Game *g, Chess_Move m) {
+  // most valuable victim first, then least valuable attacker
+  Chess_Kind victim = chess_piece_kind(g->board[chess_move_to(m)]);
+  if(chess_move_flags(m) == CHESS_MOVE_FLAG_EN_PASSANT) {
+    victim = CHESS_KIND_PAWN;
+  }
+  Chess_Kind attacker = chess_piece_kind(g->board[chess_move_from(m)]);
+  return (int) victim * 8 + (CHESS_KIND_KING - (int) attacker) +
+    (chess_move_promotion(m) == CHESS_KIND_QUEEN ? 64 : 0);
+}
+
+static inline void chess_search_picker_init(Chess_Search_Picker *p, Chess_Search *s,
+					    Chess_Move table_move, int quiets) {
+  p->stage = CHESS_SEARCH_STAGE_TABLE;
+  p->quiets = quiets;
+  p->table_move = table_move;
+  p->killers[0] = 0;
+  p->killers[1] = 0;
+  p->counter = 0;
+  if(!quiets) {
+    return;
+  }
+
+  Chess_Game *g = s->game;
+  p->killers[0] = s->killers[s->ply][0];
+  p->killers[1] = s->killers[s->ply][1];
+  if(g->history_len > 0) {
+    Chess_Move last = chess_game_history_at(g, g->history_len - 1);
+    p->counter = s->counter[chess_move_from(last)][chess_move_to(last)];
+  }
+}
+
+static inline Chess_Move chess_search_picker_take(Chess_Search_Picker *p) {
+  // the best scored of the rest, a sort would score every move in vain
+  // on a cutoff
+  int best = p->next;
+  for(int i=p->next + 1;i<p->len;i++) {
+    if(p->scores[i] > p->scores[best]) {
+      best = i;
+    }
+  }
+  Chess_Move m = p->moves[best];
+  int score = p->scores[best];
+  p->moves[best] = p->moves[p->next];
+  p->scores[best] = p->scores[p->next];
+  p->moves[p->next] = m;
+  p->scores[p->next] = score;
+  p->next++;
+  return m;
+}
+
+static inline int chess_search_picker_seen(Chess_Search_Picker *p, Chess_Move m) {
+  // moves of the earlier stages, that come up again when generating
+  return m == p->table_move || m == p->killers[0] || m == p->killers[1] || m == p->counter;
+}
+
+// Returns 0, once every legal move came out
+static Chess_Move chess_search_picker_next(Chess_Search_Picker *p, Chess_Search *s) {
+  Chess_Game *g = s->game;
+  Chess_Move m;
+
+  switch(p->stage) {
+
+  case CHESS_SEARCH_STAGE_TABLE:
+    p->stage = CHESS_SEARCH_STAGE_CAPTURES_GENERATE;
+    // the table may hold a move of another position with the same bucket
+    if(p->table_move && chess_game_is_legal(g, p->table_move)) {
+      return p->table_move;
+    }
+    p->table_move = 0;
+    // fallthrough
+
+  case CHESS_SEARCH_STAGE_CAPTURES_GENERATE:
+    p->len = chess_game_generate_legal(g, CHESS_GENERATE_CAPTURES, p->moves, CHESS_MOVES_CAP);
+    for(int i=0;i<p->len;i++) {
+      p->scores[i] = chess_search_capture_order(g, p->moves[i]);
+    }
+    p->next = 0;
+    p->stage = CHESS_SEARCH_STAGE_CAPTURES;
+    // fallthrough
+
+  case CHESS_SEARCH_STAGE_CAPTURES:
+    while(p->next < p->len) {
+      m = chess_search_picker_take(p);
+      if(m != p->table_move) {
+	return m;
+      }
+    }
+    if(!p->quiets) {
+      p->stage = CHESS_SEARCH_STAGE_DONE;
+      return 0;
+    }
+    p->next = 0;
+    p->stage = CHESS_SEARCH_STAGE_KILLERS;
+    // fallthrough
+
+  case CHESS_SEARCH_STAGE_KILLERS:
+    // killers come from other positions of the same ply, so check them
+    while(p->next < 2) {
+      m = p->killers[p->next++];
+      if(m && m != p->table_move && chess_search_is_quiet(g, m) && chess_game_is_legal(g, m)) {
+	return m;
+      }
+    }
+    p->stage = CHESS_SEARCH_STAGE_COUNTER;
+    // fallthrough
+
+  case CHESS_SEARCH_STAGE_COUNTER:
+    p->stage = CHESS_SEARCH_STAGE_QUIETS_GENERATE;
+    m = p->counter;
+    if(m && m != p->table_move && m != p->killers[0] && m != p->killers[1] &&
+       chess_search_is_quiet(g, m) && chess_game_is_legal(g, m)) {
+      return m;
+    }
+    // fallthrough
+
+  case CHESS_SEARCH_STAGE_QUIETS_GENERATE:
+    p->len = chess_game_generate_legal(g, CHESS_GENERATE_QUIETS, p->moves, CHESS_MOVES_CAP);
+    for(int i=0;i<p->len;i++) {
+      m = p->moves[i];
+      p->scores[i] = s->history[g->blacks_turn][chess_move_from(m)][chess_move_to(m)];
+    }
+    p->next = 0;
+    p->stage = CHESS_SEARCH_STAGE_QUIETS;
+    // fallthrough
+
+  case CHESS_SEARCH_STAGE_QUIETS:
+    while(p->next < p->len) {
+      m = chess_search_picker_take(p);
+      if(!chess_search_picker_seen(p, m)) {
+	return m;
+      }
+    }
+    p->stage = CHESS_SEARCH_STAGE_DONE;
+    // fallthrough
+
+  case CHESS_SEARCH_STAGE_DONE:
+    break;
+  }
+
+  return 0;
+}
+
+static inline void chess_search_history_add(int *h, int bonus) {
+  // moves towards +-CHESS_SEARCH_HISTORY_MAX, slower the closer it gets
+  int magnitude = bonus < 0 ? -bonus : bonus;
+  *h += bonus - *h * magnitude / CHESS_SEARCH_HISTORY_MAX;
+}
+
+static inline void chess_search_cutoff(Chess_Search *s, Chess_Move m, int depth,
+				       Chess_Move *tried, int tried_len) {
+  // m, a quiet move, refuted the last move. tried are the quiet moves
+  // before it, that did not
+  Chess_Game *g = s->game;
+  Chess_Move *killers = s->killers[s->ply];
+  if(killers[0] != m) {
+    killers[1] = killers[0];
+    killers[0] = m;
+  }
+
+  if(g->history_len > 0) {
+    Chess_Move last = chess_game_history_at(g, g->history_len - 1);
+    s->counter[chess_move_from(last)][chess_move_to(last)] = m;
+  }
+
+  int (*history)[CHESS_N * CHESS_N] = s->history[g->blacks_turn];
+  int bonus = depth * depth;
+  chess_search_history_add(&history[chess_move_from(m)][chess_move_to(m)], bonus);
+  for(int i=0;i<tried_len;i++) {
+    chess_search_history_add(&history[chess_move_from(tried[i])][chess_move_to(tried[i])], -bonus);
+  }
+}
+
+static int chess_search_quiesce(Chess_Search *s, int alpha, int beta) {
+  Chess_Game *g = s->game;
+  s->nodes++;
+  if(chess_search_should_stop(s)) {
+    return 0;
+  }
+
+  int stand_pat = chess_search_evaluate(g);
+  if(stand_pat >= beta) {
+    return stand_pat;
+  }
+  if(stand_pat > alpha) {
+    alpha = stand_pat;
+  }
+
+  Chess_Search_Picker picker;
+  chess_search_picker_init(&picker, s, 0, 0);
+  Chess_Move m;
+  while((m = chess_search_picker_next(&picker, s)) != 0) {
+    // underpromotions are left to the full search
+    if(chess_move_promotion(m) != CHESS_KIND_NONE && chess_move_promotion(m) != CHESS_KIND_QUEEN) {
+      continue;
+    }
+
+    chess_game_perform_move(g, m);
+    s->ply++;
+    int score = -chess_search_quiesce(s, -beta, -alpha);
+    s->ply--;
+    chess_game_unmake(g);
+
+    if(s->stopped) {
+      return 0;
+    }
+    if(score >= beta) {
+      return score;
+    }
+    if(score > alpha) {
+      alpha = score;
+    }
+  }
+
+  return alpha;
+}
+
+static int chess_search_negamax(Chess_Search *s, int depth, int alpha, int beta, Chess_Move *best) {
+  Chess_Game *g = s->game;
+  if(s->ply > 0 && chess_search_is_draw(g)) {
+    return 0;
+  }
+
+  int in_check = chess_game_checkers(g) != 0;
+  if(in_check) {
+    depth++;
+  }
+  if(depth <= 0 || s->ply >= CHESS_SEARCH_MAX_DEPTH) {
+    return chess_search_quiesce(s, alpha, beta);
+  }
+
+  s->nodes++;
+  if(chess_search_should_stop(s)) {
+    return 0;
+  }
+
+  Chess_Search_Table *table = s->shared->table;
+  Chess_Move table_move = best ? *best : 0;
+  if(table) {
+    Chess_Move move;
+    int score, table_depth, bound;
+    if(chess_search_table_probe(table, g->key, &move, &score, &table_depth, &bound)) {
+      score = chess_search_score_from_table(score, s->ply);
+      if(s->ply > 0 && table_depth >= depth &&
+	 (bound == CHESS_SEARCH_BOUND_EXACT ||
+	  (bound == CHESS_SEARCH_BOUND_LOWER && score >= beta) ||
+	  (bound == CHESS_SEARCH_BOUND_UPPER && score <= alpha))) {
+	return score;
+      }
+      if(!table_move) {
+	table_move = move;
+      }
+    }
+  }
+
+  Chess_Search_Picker picker;
+  chess_search_picker_init(&picker, s, table_move, 1);
+
+  int alpha_start = alpha;
+  int best_score = -CHESS_SEARCH_INF;
+  Chess_Move best_move = 0;
+  int searched = 0;
+  Chess_Move tried[CHESS_MOVES_CAP]; // quiet moves, that did not cut off
+  int tried_len = 0;
+  Chess_Move m;
+  while((m = chess_search_picker_next(&picker, s)) != 0) {
+    int quiet = chess_search_is_quiet(g, m);
+    chess_game_perform_move(g, m);
+    s->ply++;
+    int score = -chess_search_negamax(s, depth - 1, -beta, -alpha, NULL);
+    s->ply--;
+    chess_game_unmake(g);
+    searched++;
+
+    if(s->stopped) {
+      return 0;
+    }
+    if(score > best_score) {
+      best_score = score;
+      best_move = m;
+    }
+    if(score > alpha) {
+      alpha = score;
+    }
+    if(alpha >= beta) {
+      if(quiet) {
+	chess_search_cutoff(s, m, depth, tried, tried_len);
+      }
+      break;
+    }
+    if(quiet) {
+      tried[tried_len++] = m;
+    }
+  }
+
+  if(searched == 0) {
+    return in_check ? -CHESS_SEARCH_MATE + s->ply : 0;
+  }
+
+  if(best) *best = best_move;
+  if(table) {
+    int bound = best_score >= beta ? CHESS_SEARCH_BOUND_LOWER
+      : best_score > alpha_start ? CHESS_SEARCH_BOUND_EXACT
+      : CHESS_SEARCH_BOUND_UPPER;
+    chess_search_table_store(table, g->key, best_score > alpha_start ? best_move : 0,
+			     chess_search_score_to_table(best_score, s->ply), depth, bound);
+  }
+
+  return best_score;
+}
+
+static inline void chess_search_iterate(Chess_Search *s) {
+  // helpers start one ply deeper every other thread, so that the threads
+  // spread over different depths and fill the table for each other
+  Chess_Search_Shared *shared = s->shared;
+  for(int depth=1 + (s->id & 1);depth<=shared->max_depth;depth++) {
+    // the best move of the last iteration is searched first
+    Chess_Move best = s->best;
+    int score = chess_search_negamax(s, depth, -CHESS_SEARCH_INF, CHESS_SEARCH_INF, &best);
+    if(s->stopped) {
+      break;
+    }
+
+    s->best = best;
+    s->score = score;
+    s->depth = depth;
+
+    // nothing left to find, once a mate is certain
+    if(score >= CHESS_SEARCH_MATE - depth || score <= -CHESS_SEARCH_MATE + depth) {
+      break;
+    }
+  }
+}
+
+static void chess_search_worker(void *arg) {
+  chess_search_iterate((Chess_Search *) arg);
+}
+
+CHESS_SEARCH_DEF int chess_search(Chess_Game *g, Chess_Search_Table *table,
+				  Chess_Search_Limits limits, Chess_Search_Result *result) {
+  Chess_Search_Shared shared = {0};
+  shared.table = table;
+  shared.limits = limits;
+  shared.start = chess_search_now();
+  shared.max_depth = limits.depth > 0 && limits.depth < CHESS_SEARCH_MAX_DEPTH
+    ? limits.depth
+    : CHESS_SEARCH_MAX_DEPTH;
+  if(table) {
+    table->age++;
+  }
+
+  result->best = 0;
+  result->score = 0;
+  result->depth = 0;
+  result->nodes = 0;
+  result->seconds = 0;
+
+  Chess_Move moves[CHESS_MOVES_CAP];
+  int len = chess_game_generate_legal_moves(g, moves, CHESS_MOVES_CAP);
+  if(len == 0) {
+    return 0;
+  }
+
+  // searches[0] runs on this thread, on g
+  int threads_len = limits.threads > 1 ? limits.threads : 1;
+  Chess_Search *searches = CHESS_REALLOC(NULL, threads_len * sizeof(Chess_Search));
+  Chess_Thread *threads = CHESS_REALLOC(NULL, threads_len * sizeof(Chess_Thread));
+  if(!searches || !threads) {
+    threads_len = 1;
+  }
+  Chess_Search single = {0};
+  if(!searches) {
+    searches = &single;
+  }
+
+  int helpers_len = 0;
+  for(int i=0;i<threads_len;i++) {
+    Chess_Search *s = &searches[i];
+    *s = (Chess_Search) {0};
+    s->shared = &shared;
+    s->id = i;
+    s->best = moves[0];
+    s->game = g;
+    if(i == 0) {
+      continue;
+    }
+
+    // without a copy or a thread, the search just has fewer helpers
+    if(!chess_game_copy(&s->copy, g)) {
+      break;
+    }
+    s->game = &s->copy;
+    if(!chess_thread_create(&threads[i], chess_search_worker, s)) {
+      chess_game_free(&s->copy);
+      break;
+    }
+    helpers_len++;
+  }
+
+  chess_search_iterate(&searches[0]);
+  chess_atomic_store(&shared.stop, 1);
+
+  // the deepest complete iteration wins, the first thread on a tie
+  Chess_Search *best = &searches[0];
+  unsigned long long nodes = searches[0].nodes;
+  for(int i=1;i<=helpers_len;i++) {
+    chess_thread_join(&threads[i]);
+    chess_game_free(&searches[i].copy);
+    if(searches[i].depth > best->depth) {
+      best = &searches[i];
+    }
+    nodes += searches[i].nodes;
+  }
+
+  result->best = best->best;
+  result->score = best->score;
+  result->depth = best->depth;
+  result->nodes = nodes;
+  result->seconds = chess_search_now() - shared.start;
+
+  if(searches != &single) CHESS_FREE(searches);
+  if(threads) CHESS_FREE(threads);
+  return 1;
+}
+
+#endif // CHESS_SEARCH_IMPLEMENTATION
+
+#endif // CHESS_SEARCH_H
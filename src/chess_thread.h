@@ -0,0 +1,116 @@
+#ifndef CHESS_THREAD_H
+#define CHESS_THREAD_H
+
+#ifndef CHESS_THREAD_DEF
+#  define CHESS_THREAD_DEF static inline
+#endif // CHESS_THREAD_DEF
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <unistd.h>
+#endif // _WIN32
+
+typedef void (*Chess_Thread_Proc)(void *arg);
+
+typedef struct {
+#ifdef _WIN32
+  HANDLE handle;
+#else
+  pthread_t handle;
+#endif // _WIN32
+  Chess_Thread_Proc proc;
+  void *arg;
+} Chess_Thread;
+
+// t must stay valid until chess_thread_join
+CHESS_THREAD_DEF int chess_thread_create(Chess_Thread *t, Chess_Thread_Proc proc, void *arg);
+CHESS_THREAD_DEF void chess_thread_join(Chess_Thread *t);
+CHESS_THREAD_DEF int chess_thread_count();
+
+// Sequentially consistent, return the previous value
+CHESS_THREAD_DEF long long chess_atomic_add(volatile long long *p, long long value);
+CHESS_THREAD_DEF long long chess_atomic_load(volatile long long *p);
+CHESS_THREAD_DEF void chess_atomic_store(volatile long long *p, long long value);
+
+#ifdef CHESS_THREAD_IMPLEMENTATION
+
+#ifdef _WIN32
+
+static DWORD WINAPI chess_thread_start(LPVOID arg) {
+  Chess_Thread *t = arg;
+  t->proc(t->arg);
+  return 0;
+}
+
+CHESS_THREAD_DEF int chess_thread_create(Chess_Thread *t, Chess_Thread_Proc proc, void *arg) {
+  t->proc = proc;
+  t->arg = arg;
+  t->handle = CreateThread(NULL, 0, chess_thread_start, t, 0, NULL);
+  return t->handle != NULL;
+}
+
+CHESS_THREAD_DEF void chess_thread_join(Chess_Thread *t) {
+  WaitForSingleObject(t->handle, INFINITE);
+  CloseHandle(t->handle);
+}
+
+CHESS_THREAD_DEF int chess_thread_count() {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int) info.dwNumberOfProcessors;
+}
+
+CHESS_THREAD_DEF long long chess_atomic_add(volatile long long *p, long long value) {
+  return InterlockedExchangeAdd64(p, value);
+}
+
+CHESS_THREAD_DEF long long chess_atomic_load(volatile long long *p) {
+  return InterlockedCompareExchange64(p, 0, 0);
+}
+
+CHESS_THREAD_DEF void chess_atomic_store(volatile long long *p, long long value) {
+  InterlockedExchange64(p, value);
+}
+
+#else
+
+static void *chess_thread_start(void *arg) {
+  Chess_Thread *t = arg;
+  t->proc(t->arg);
+  return NULL;
+}
+
+CHESS_THREAD_DEF int chess_thread_create(Chess_Thread *t, Chess_Thread_Proc proc, void *arg) {
+  t->proc = proc;
+  t->arg = arg;
+  return pthread_create(&t->handle, NULL, chess_thread_start, t) == 0;
+}
+
+CHESS_THREAD_DEF void chess_thread_join(Chess_Thread *t) {
+  pthread_join(t->handle, NULL);
+}
+
+CHESS_THREAD_DEF int chess_thread_count() {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int) n : 1;
+}
+
+CHESS_THREAD_DEF long long chess_atomic_add(volatile long long *p, long long value) {
+  return __atomic_fetch_add(p, value, __ATOMIC_SEQ_CST);
+}
+
+CHESS_THREAD_DEF long long chess_atomic_load(volatile long long *p) {
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+CHESS_THREAD_DEF void chess_atomic_store(volatile long long *p, long long value) {
+  __atomic_store_n(p, value, __ATOMIC_SEQ_CST);
+}
+
+#endif // _WIN32
+
+#endif // CHESS_THREAD_IMPLEMENTATION
+
+#endif // CHESS_THREAD_H
@@ -141,7 +141,8 @@ int main(int argc, char **argv) {
 	if(buf_len < sizeof(Chess_Move)) {
 	  // Keep reading ...
 	} else if(buf_len == sizeof(Chess_Move)) {
-	  if(!chess_game_move(&game, (Chess_Move *) buf)) TODO();
+	  memcpy(&move, buf, sizeof(Chess_Move));
+	  if(!chess_game_move(&game, &move)) TODO();
 	  blacks_turn = 1 - blacks_turn;
 	} else { // buf_len > sizeof(Chess_Move)
 	  TODO();
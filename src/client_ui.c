@@ -226,7 +226,8 @@ PNM_DEF void *pnm_load_from_memory(const unsigned char *data, u64 data_len, int
 	  if(buf_len < sizeof(Chess_Move)) {
 	    // Keep reading ...
 	  } else if(buf_len == sizeof(Chess_Move)) {
-	    if(!chess_game_move(&game, (Chess_Move *) buf)) TODO();
+	    memcpy(&move, buf, sizeof(Chess_Move));
+	    if(!chess_game_move(&game, &move)) TODO();
 	    blacks_turn = 1 - blacks_turn;
 	  } else { // buf_len > sizeof(Chess_Move)
 	    TODO();
@@ -250,11 +251,12 @@ PNM_DEF void *pnm_load_from_memory(const unsigned char *data, u64 data_len, int
 	  frame.running = 0;
 	}
 	if(event.as.key == 'R') {
+	  chess_game_free(&game);
 	  chess_game_default(&game);
 	}
 	if(event.as.key == 'B') {
 	  if(game.history_len > 0) {
-	    chess_game_rewind(&game, game.history_len - 1);
+	    chess_game_unmake(&game);
 	  }
 	  
 	}
@@ -286,10 +288,7 @@ PNM_DEF void *pnm_load_from_memory(const unsigned char *data, u64 data_len, int
 	s32 x = (s32) (frame.mouse_x / cell_size.x);
 	s32 y = (s32) (frame.mouse_y / cell_size.y);
 
-	move = (Chess_Move) {
-	  .from = dragged_piece_index,
-	  .to   = x + (CHESS_N - y - 1)*CHESS_N,
-	};
+	move = CHESS_MOVE(dragged_piece_index, x + (CHESS_N - y - 1)*CHESS_N, 0);
 
 	if(started && black == blacks_turn && message.len == 0)  {
 	  // chess_game_move(&game, &move);
@@ -316,13 +315,23 @@ PNM_DEF void *pnm_load_from_memory(const unsigned char *data, u64 data_len, int
     
     Mui_Vec2f piece_size = mui_vec2f(piece_w, piece_h);
 
+    // where the dragged piece may be dropped
+    Chess_Bitboard targets = 0;
+    if(dragged_piece_index >= 0 && started && black == blacks_turn) {
+      targets = chess_game_legal_targets(&game, dragged_piece_index);
+    }
+
     for(s32 y=0;y<CHESS_N;y++) {
       for(s32 x=0;x<CHESS_N;x++) {
 	
 	Mui_Vec2f cell_pos = mui_vec2f(x*cell_size.x, y*cell_size.y);
 
+	s32 index = x + (CHESS_N - y - 1)*CHESS_N;
+
 	Mui_Vec4f color;
-	if((y + x) & 0x1) {
+	if(targets & CHESS_BIT(index)) {
+	  color = mui_vec4f(0.4f, 0.6f, 0.35f, 1);
+	} else if((y + x) & 0x1) {
 	  color = mui_vec4f(0.16470f, 0.1686f, 0.3137f, 1);
 	} else {
 	  color = mui_vec4f(0.7372f, 0.7372f, 0.7372f, 1);
@@ -333,10 +342,8 @@ PNM_DEF void *pnm_load_from_memory(const unsigned char *data, u64 data_len, int
 		 cell_size,
 		 color);
 
-	s32 index = x + (CHESS_N - y - 1)*CHESS_N;
-
-	Chess_Piece *p = &game.board[index];
-	if(p->kind == CHESS_KIND_NONE) {
+	Chess_Piece p = game.board[index];
+	if(p == CHESS_PIECE_NONE) {
 	  continue;
 	}
 
@@ -354,8 +361,8 @@ PNM_DEF void *pnm_load_from_memory(const unsigned char *data, u64 data_len, int
 		    &pieces_texture,
 		    cell_pos,
 		    cell_size,
-		    mui_vec2f(chess_piece_to_x[p->kind]*(piece_w+piece_padding_w),
-			      (1 - p->black)*(piece_h+piece_padding_h)),
+		    mui_vec2f(chess_piece_to_x[chess_piece_kind(p)]*(piece_w+piece_padding_w),
+			      (1 - chess_piece_black(p))*(piece_h+piece_padding_h)),
 		    piece_size,
 		    mui_vec4f(1, 1, 1, 1));
 	
@@ -363,14 +370,14 @@ PNM_DEF void *pnm_load_from_memory(const unsigned char *data, u64 data_len, int
     }
 
     if(dragged_piece_index >= 0) {
-      Chess_Piece *p = &game.board[dragged_piece_index];
+      Chess_Piece p = game.board[dragged_piece_index];
       
       mui_texture(&mui,
 		  &pieces_texture,
 		  mui_vec2f(frame.mouse_x - cell_size.x/2, frame.mouse_y - cell_size.y/2),
 		  cell_size,
-		  mui_vec2f(chess_piece_to_x[p->kind]*(piece_w+piece_padding_w),
-			    (1 - p->black)*(piece_h+piece_padding_h)),
+		  mui_vec2f(chess_piece_to_x[chess_piece_kind(p)]*(piece_w+piece_padding_w),
+			    (1 - chess_piece_black(p))*(piece_h+piece_padding_h)),
 		  piece_size,
 		  mui_vec4f(1, 1, 1, 1));      
     }
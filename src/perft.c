@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CHESS_IMPLEMENTATION
+#include "chess.h"
+
+#define CHESS_THREAD_IMPLEMENTATION
+#include "chess_thread.h"
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Node counts of subtrees, shared by all threads without locks. An
+// entry stores (key ^ data, data), so a torn write from two threads
+// fails the check and reads as a miss
+typedef struct {
+  volatile unsigned long long check;
+  volatile unsigned long long data; // nodes << 8 | depth
+} Hash_Entry;
+
+typedef struct {
+  Hash_Entry *entries;
+  unsigned long long mask;
+} Hash;
+
+typedef struct {
+  unsigned long long probes;
+  unsigned long long hits;
+} Hash_Stats;
+
+// Relaxed, the check catches entries written half by another thread
+static inline unsigned long long hash_entry_load(volatile unsigned long long *p) {
+#ifdef _MSC_VER
+  return *p;
+#else
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+#endif // _MSC_VER
+}
+
+static inline void hash_entry_store(volatile unsigned long long *p, unsigned long long value) {
+#ifdef _MSC_VER
+  *p = value;
+#else
+  __atomic_store_n(p, value, __ATOMIC_RELAXED);
+#endif // _MSC_VER
+}
+
+int hash_init(Hash *hash, unsigned long long megabytes) {
+  unsigned long long len = 1;
+  while(len * 2 * sizeof(Hash_Entry) <= megabytes * 1024 * 1024) {
+    len *= 2;
+  }
+  hash->entries = calloc(len, sizeof(Hash_Entry));
+  hash->mask = len - 1;
+  return hash->entries != NULL;
+}
+
+unsigned long long perft(Chess_Game *g, int depth, Hash *hash, Hash_Stats *stats) {
+  if(depth == 0) {
+    return 1;
+  }
+  
+  Chess_Move moves[CHESS_MOVES_CAP];
+  int len = chess_game_generate_legal_moves(g, moves, CHESS_MOVES_CAP);
+  if(depth == 1) {
+    return (unsigned long long) len;
+  }
+
+  Hash_Entry *entry = NULL;
+  if(hash) {
+    entry = &hash->entries[g->key & hash->mask];
+    unsigned long long data = hash_entry_load(&entry->data);
+    unsigned long long check = hash_entry_load(&entry->check);
+    stats->probes++;
+    if((check ^ data) == g->key && (data & 0xff) == (unsigned long long) depth) {
+      stats->hits++;
+      return data >> 8;
+    }
+  }
+
+  unsigned long long nodes = 0;
+  for(int i=0;i<len;i++) {
+    chess_game_perform_move(g, moves[i]);
+    nodes += perft(g, depth - 1, hash, stats);
+    chess_game_unmake(g);
+  }
+
+  if(entry) {
+    unsigned long long data = (nodes << 8) | (unsigned long long) depth;
+    hash_entry_store(&entry->check, g->key ^ data);
+    hash_entry_store(&entry->data, data);
+  }
+  
+  return nodes;
+}
+
+// The subtree below a root move and one reply
+typedef struct {
+  int root;
+  Chess_Move root_move;
+  Chess_Move reply;
+} Task;
+
+// Workers take the next task from a shared cursor, so threads that
+// drew small subtrees just take more of them
+typedef struct {
+  Chess_Game *game;
+  int depth; // below the tasks
+  Hash *hash;
+  volatile long long probes;
+  volatile long long hits;
+  
+  Task *tasks;
+  long long tasks_len;
+  volatile long long next;
+
+  volatile long long nodes[CHESS_MOVES_CAP]; // per root move
+} Pool;
+
+void worker(void *arg) {
+  Pool *pool = arg;
+
+  Chess_Game game;
+  if(!chess_game_copy(&game, pool->game)) {
+    fprintf(stderr, "ERROR: Cannot copy game\n");
+    exit(1);
+  }
+
+  Hash_Stats stats = {0};
+  
+  while(1) {
+    long long i = chess_atomic_add(&pool->next, 1);
+    if(i >= pool->tasks_len) {
+      break;
+    }
+    Task *t = &pool->tasks[i];
+
+    chess_game_perform_move(&game, t->root_move);
+    chess_game_perform_move(&game, t->reply);
+    unsigned long long n = perft(&game, pool->depth, pool->hash, &stats);
+    chess_game_unmake(&game);
+    chess_game_unmake(&game);
+
+    chess_atomic_add(&pool->nodes[t->root], (long long) n);
+  }
+
+  chess_atomic_add(&pool->probes, (long long) stats.probes);
+  chess_atomic_add(&pool->hits, (long long) stats.hits);
+
+  chess_game_free(&game);
+}
+
+double now() {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+void usage(char *program) {
+  fprintf(stderr, "USAGE: %s [-divide] [-threads <n>] [-hash <mb>] [-fen <fen>] <depth>\n", program);
+}
+
+int main(int argc, char **argv) {
+
+  char *program = argv[0];
+  char *fen = START_FEN;
+  int divide = 0;
+  int depth = -1;
+  int threads_len = chess_thread_count();
+  int hash_mb = 0;
+
+  for(int i=1;i<argc;i++) {
+    if(strcmp(argv[i], "-divide") == 0) {
+      divide = 1;
+    } else if(strcmp(argv[i], "-fen") == 0 && i + 1 < argc) {
+      fen = argv[++i];
+    } else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+      threads_len = atoi(argv[++i]);
+      if(threads_len < 1) threads_len = 1;
+    } else if(strcmp(argv[i], "-hash") == 0 && i + 1 < argc) {
+      hash_mb = atoi(argv[++i]);
+    } else if(depth < 0) {
+      depth = atoi(argv[i]);
+    } else {
+      usage(program);
+      return 1;
+    }
+  }
+  if(depth < 0) {
+    fprintf(stderr, "ERROR: Please provide a depth\n");
+    usage(program);
+    return 1;
+  }
+
+  Chess_Game game;
+  chess_game_default(&game);
+  if(!chess_game_from_fen(&game, fen)) {
+    fprintf(stderr, "ERROR: Cannot parse fen '%s'\n", fen);
+    return 1;
+  }
+
+  Chess_Move moves[CHESS_MOVES_CAP];
+  int len = chess_game_generate_legal_moves(&game, moves, CHESS_MOVES_CAP);
+  
+  Pool *pool = calloc(1, sizeof(Pool));
+  Task *tasks = malloc(sizeof(Task) * (len * CHESS_MOVES_CAP + 1));
+  Chess_Thread *threads = malloc(sizeof(Chess_Thread) * threads_len);
+  if(!pool || !tasks || !threads) {
+    fprintf(stderr, "ERROR: Out of memory\n");
+    return 1;
+  }
+
+  Hash hash = {0};
+  if(hash_mb > 0) {
+    if(!hash_init(&hash, (unsigned long long) hash_mb)) {
+      fprintf(stderr, "ERROR: Cannot allocate %d MB for the hash\n", hash_mb);
+      return 1;
+    }
+    pool->hash = &hash;
+  }
+
+  double start = now();
+  
+  if(depth >= 2) {
+    // split the tree two plies deep
+    for(int i=0;i<len;i++) {
+      chess_game_perform_move(&game, moves[i]);
+      Chess_Move replies[CHESS_MOVES_CAP];
+      int replies_len = chess_game_generate_legal_moves(&game, replies, CHESS_MOVES_CAP);
+      for(int j=0;j<replies_len;j++) {
+	tasks[pool->tasks_len++] = (Task) {
+	  .root = i,
+	  .root_move = moves[i],
+	  .reply = replies[j],
+	};
+      }
+      chess_game_unmake(&game);
+    }
+    pool->game = &game;
+    pool->depth = depth - 2;
+    pool->tasks = tasks;
+
+    for(int i=0;i<threads_len;i++) {
+      if(!chess_thread_create(&threads[i], worker, pool)) {
+	fprintf(stderr, "ERROR: Cannot create thread\n");
+	return 1;
+      }
+    }
+    for(int i=0;i<threads_len;i++) {
+      chess_thread_join(&threads[i]);
+    }
+    
+  } else if(depth == 1) {
+    for(int i=0;i<len;i++) {
+      pool->nodes[i] = 1;
+    }
+    
+  }
+
+  unsigned long long nodes = 0;
+  if(depth == 0) {
+    nodes = 1;
+  }
+  for(int i=0;i<len;i++) {
+    if(divide) {
+      char cstr[CHESS_MOVE_CSTR_CAP];
+      chess_move_to_cstr(moves[i], cstr);
+      printf("%s: %llu\n", cstr, (unsigned long long) pool->nodes[i]);
+    }
+    nodes += (unsigned long long) pool->nodes[i];
+  }
+  if(divide) {
+    printf("\n");
+  }
+  
+  double elapsed = now() - start;
+
+  printf("threads: %d\n", threads_len);
+  printf("nodes:   %llu\n", nodes);
+  printf("time:    %.3f s\n", elapsed);
+  printf("nps:     %.0f\n", elapsed > 0 ? (double) nodes / elapsed : 0.0);
+  if(pool->hash) {
+    printf("hash:    %d MB, %lld/%lld hits (%.1f%%)\n",
+	   hash_mb, pool->hits, pool->probes,
+	   pool->probes > 0 ? 100.0 * (double) pool->hits / (double) pool->probes : 0.0);
+  }
+
+  free(threads);
+  free(tasks);
+  free(pool);
+  free(hash.entries);
+  chess_game_free(&game);
+
+  return 0;
+}
@@ -29,6 +29,7 @@ void abort_game(Ip_Sockets *s, Chess_Game *game, Player *players, u64 index) {
     *players[other_index].socket = ip_socket_invalid();	  
   }
 
+  chess_game_free(game);
   chess_game_default(game);
   memset(players, 0, sizeof(Player) * 2);
   players[0].socket = &s->sockets[0];
@@ -129,11 +130,14 @@ int main() {
 	    if(buf_len < sizeof(Chess_Move)) {
 	      // Keep reading ...
 	    } else if(buf_len == sizeof(Chess_Move)) {
-	      if(!chess_game_move(&game, (Chess_Move *) buf)) TODO();
+	      memcpy(&move, buf, sizeof(Chess_Move));
+	      move = chess_game_complete_move(&game, move);
+	      if(!(chess_game_legal_targets(&game, chess_move_from(move)) &
+		   CHESS_BIT(chess_move_to(move)))) TODO();
+	      if(!chess_game_perform_move(&game, move)) TODO();
 	      buf_len = 0;
 
 	      u64 other_index = 1 - index;
-	      memcpy(&move, buf, sizeof(Chess_Move));
 	      players[other_index].message = str_from((u8 *) &move, sizeof(Chess_Move));
 	      players[other_index].socket->flags |= IP_WRITING;
 	      keep_reading = 0;
@@ -5,6 +5,12 @@
 #define CHESS_IMPLEMENTATION
 #include "chess.h"
 
+#define CHESS_THREAD_IMPLEMENTATION
+#include "chess_thread.h"
+
+#define CHESS_SEARCH_IMPLEMENTATION
+#include "chess_search.h"
+
 #define FS_IMPLEMENTATION
 #include <core/fs.h>
 
@@ -21,7 +27,47 @@ typedef unsigned long long u64;
 #define UNREACHABLE() panic("UNREACHABLE")
 #define TODO() panic("TODO")
 
-int main() {
+void usage(char *program) {
+  fprintf(stderr, "USAGE: %s [-engine white|black] [-time <seconds>] [-hash <mb>] [-threads <n>]\n", program);
+}
+
+int main(int argc, char **argv) {
+
+  char *program = argv[0];
+  int engine = -1; // the side the engine plays, chess_piece_black or -1
+  Chess_Search_Limits limits = {0};
+  limits.seconds = 1.0;
+  limits.threads = chess_thread_count();
+  int hash_mb = 16;
+
+  for(int i=1;i<argc;i++) {
+    if(strcmp(argv[i], "-engine") == 0 && i + 1 < argc) {
+      i++;
+      if(strcmp(argv[i], "white") == 0) {
+	engine = 0;
+      } else if(strcmp(argv[i], "black") == 0) {
+	engine = 1;
+      } else {
+	usage(program);
+	return 1;
+      }
+    } else if(strcmp(argv[i], "-time") == 0 && i + 1 < argc) {
+      limits.seconds = atof(argv[++i]);
+    } else if(strcmp(argv[i], "-hash") == 0 && i + 1 < argc) {
+      hash_mb = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+      limits.threads = atoi(argv[++i]);
+    } else {
+      usage(program);
+      return 1;
+    }
+  }
+
+  Chess_Search_Table table;
+  if(engine >= 0 && !chess_search_table_init(&table, (unsigned long long) hash_mb)) {
+    fprintf(stderr, "ERROR: Cannot allocate %d MB for the hash\n", hash_mb);
+    return 1;
+  }
 
   Fs_File file_stdin;
   if(fs_file_stdin(&file_stdin) != FS_ERROR_NONE) {
@@ -35,16 +81,31 @@ int main() {
 
   while(1) {    
     chess_game_dump(&game);
-    int white_or_black;
-    if(chess_game_over(&game, &white_or_black)) {
-
-      if(white_or_black) { // white
+    switch(chess_game_status(&game)) {
+    case CHESS_STATUS_CHECKMATE:
+      if(game.blacks_turn) {
 	printf("white won\n");
-      } else {             // black
+      } else {
 	printf("black won\n");
       }
-
       return 0;
+    case CHESS_STATUS_STALEMATE:
+      printf("draw\n");
+      return 0;
+    default:
+      break;
+    }
+
+    if(game.blacks_turn == engine) {
+      Chess_Search_Result result;
+      chess_search(&game, &table, limits, &result);
+      char cstr[CHESS_MOVE_CSTR_CAP];
+      chess_move_to_cstr(result.best, cstr);
+      printf("\tENGINE: %s (depth %d, score %d, %llu nodes)\n",
+	     cstr, result.depth, result.score, result.nodes);
+      fflush(stdout);
+      chess_game_perform_move(&game, result.best);
+      continue;
     }
 
     u64 read;
@@ -61,12 +122,19 @@ int main() {
     buf[read] = '\0';
 
     if(strcmp(buf, "b") == 0) {
-      chess_game_rewind(&game, game.history_len - 1);
+      if(game.history_len > 0) {
+	chess_game_unmake(&game);
+      }
+      // also take back the engine's move, it would just play again
+      if(game.blacks_turn == engine && game.history_len > 0) {
+	chess_game_unmake(&game);
+      }
       
     } else if(strcmp(buf, "q") == 0) {
       return 0;
 
     } else if(strcmp(buf, "r") == 0) {
+      chess_game_free(&game);
       chess_game_default(&game);
       
     } else { 
@@ -74,13 +142,13 @@ int main() {
       if(chess_move_from_cstr(buf, &move)) {
 
 	printf("\tINFO: %d|(%d, %d) -> %d|(%d, %d)\n",
-	       move.from,
-	       move.from % CHESS_N,
-	       move.from / CHESS_N,
+	       chess_move_from(move),
+	       chess_move_from(move) % CHESS_N,
+	       chess_move_from(move) / CHESS_N,
 	     
-	       move.to,
-	       move.to % CHESS_N,
-	       move.to / CHESS_N);
+	       chess_move_to(move),
+	       chess_move_to(move) % CHESS_N,
+	       chess_move_to(move) / CHESS_N);
       
 	if(!chess_game_move(&game, &move)) {
 	  printf("\tERROR: Cannot perform move\n");
@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define FRAME_IMPLEMENTATION
 #include <core/frame.h>
@@ -17,6 +19,12 @@
 #define CHESS_IMPLEMENTATION
 #include "chess.h"
 
+#define CHESS_THREAD_IMPLEMENTATION
+#include "chess_thread.h"
+
+#define CHESS_SEARCH_IMPLEMENTATION
+#include "chess_search.h"
+
 #define WIDTH 800
 #define HEIGHT 800
 
@@ -59,7 +67,45 @@ s32 chess_piece_to_x[] = {
   [CHESS_KIND_KING] = 0,
 };
 
-int main() {
+void usage(char *program) {
+  fprintf(stderr, "USAGE: %s [-engine white|black] [-time <seconds>] [-hash <mb>] [-threads <n>]\n", program);
+}
+
+int main(int argc, char **argv) {
+
+  // -engine white|black lets the engine play that side
+  int engine = -1;
+  Chess_Search_Limits limits = {0};
+  limits.seconds = 1.0;
+  limits.threads = chess_thread_count();
+  int hash_mb = 16;
+  for(int i=1;i<argc;i++) {
+    if(strcmp(argv[i], "-engine") == 0 && i + 1 < argc) {
+      i++;
+      if(strcmp(argv[i], "white") == 0) {
+	engine = 0;
+      } else if(strcmp(argv[i], "black") == 0) {
+	engine = 1;
+      } else {
+	usage(argv[0]);
+	return 1;
+      }
+    } else if(strcmp(argv[i], "-time") == 0 && i + 1 < argc) {
+      limits.seconds = atof(argv[++i]);
+    } else if(strcmp(argv[i], "-hash") == 0 && i + 1 < argc) {
+      hash_mb = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+      limits.threads = atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  Chess_Search_Table table;
+  if(engine >= 0 && !chess_search_table_init(&table, (unsigned long long) hash_mb)) {
+    TODO();
+  }
 
   Frame frame;
   if(frame_open(&frame, WIDTH, HEIGHT, 0) != FRAME_ERROR_NONE) {
@@ -110,11 +156,15 @@ int main() {
 	  frame.running = 0;
 	}
 	if(event.as.key == 'R') {
+	  chess_game_free(&game);
 	  chess_game_default(&game);
 	}
 	if(event.as.key == 'B') {
 	  if(game.history_len > 0) {
-	    chess_game_rewind(&game, game.history_len - 1);  
+	    chess_game_unmake(&game);
+	  }
+	  if(game.blacks_turn == engine && game.history_len > 0) {
+	    chess_game_unmake(&game);
 	  }
 	  
 	}
@@ -143,10 +193,7 @@ int main() {
 	s32 x = (s32) (frame.mouse_x / cell_size.x);
 	s32 y = (s32) (frame.mouse_y / cell_size.y);
 
-	Chess_Move move = {
-	  .from = dragged_piece_index,
-	  .to   = x + (CHESS_N - y - 1)*CHESS_N,
-	};
+	Chess_Move move = CHESS_MOVE(dragged_piece_index, x + (CHESS_N - y - 1)*CHESS_N, 0);
 
 	chess_game_move(&game, &move);
         
@@ -165,13 +212,23 @@ int main() {
     
     Mui_Vec2f piece_size = mui_vec2f(piece_w, piece_h);
 
+    // where the dragged piece may be dropped
+    Chess_Bitboard targets = 0;
+    if(dragged_piece_index >= 0) {
+      targets = chess_game_legal_targets(&game, dragged_piece_index);
+    }
+
     for(s32 y=0;y<CHESS_N;y++) {
       for(s32 x=0;x<CHESS_N;x++) {
 	
 	Mui_Vec2f cell_pos = mui_vec2f(x*cell_size.x, y*cell_size.y);
 
+	s32 index = x + (CHESS_N - y - 1)*CHESS_N;
+
 	Mui_Vec4f color;
-	if((y + x) & 0x1) {
+	if(targets & CHESS_BIT(index)) {
+	  color = mui_vec4f(0.4f, 0.6f, 0.35f, 1);
+	} else if((y + x) & 0x1) {
 	  color = mui_vec4f(0.16470f, 0.1686f, 0.3137f, 1);
 	} else {
 	  color = mui_vec4f(0.7372f, 0.7372f, 0.7372f, 1);
@@ -182,10 +239,8 @@ int main() {
 		 cell_size,
 		 color);
 
-	s32 index = x + (CHESS_N - y - 1)*CHESS_N;
-
-	Chess_Piece *p = &game.board[index];
-	if(p->kind == CHESS_KIND_NONE) {
+	Chess_Piece p = game.board[index];
+	if(p == CHESS_PIECE_NONE) {
 	  continue;
 	}
 
@@ -203,8 +258,8 @@ int main() {
 		    &pieces_texture,
 		    cell_pos,
 		    cell_size,
-		    mui_vec2f(chess_piece_to_x[p->kind]*(piece_w+piece_padding_w),
-			      (1 - p->black)*(piece_h+piece_padding_h)),
+		    mui_vec2f(chess_piece_to_x[chess_piece_kind(p)]*(piece_w+piece_padding_w),
+			      (1 - chess_piece_black(p))*(piece_h+piece_padding_h)),
 		    piece_size,
 		    mui_vec4f(1, 1, 1, 1));
 	
@@ -212,14 +267,14 @@ int main() {
     }
 
     if(dragged_piece_index >= 0) {
-      Chess_Piece *p = &game.board[dragged_piece_index];
+      Chess_Piece p = game.board[dragged_piece_index];
       
       mui_texture(&mui,
 		  &pieces_texture,
 		  mui_vec2f(frame.mouse_x - cell_size.x/2, frame.mouse_y - cell_size.y/2),
 		  cell_size,
-		  mui_vec2f(chess_piece_to_x[p->kind]*(piece_w+piece_padding_w),
-			    (1 - p->black)*(piece_h+piece_padding_h)),
+		  mui_vec2f(chess_piece_to_x[chess_piece_kind(p)]*(piece_w+piece_padding_w),
+			    (1 - chess_piece_black(p))*(piece_h+piece_padding_h)),
 		  piece_size,
 		  mui_vec4f(1, 1, 1, 1));      
     }
@@ -228,6 +283,15 @@ int main() {
     renderer_end(&renderer);
 
     frame_swap_buffers(&frame);
+
+    // after the frame, so the last move is shown while thinking
+    if(game.blacks_turn == engine && dragged_piece_index < 0 &&
+       chess_game_status(&game) == CHESS_STATUS_PLAYING) {
+      Chess_Search_Result result;
+      if(chess_search(&game, &table, limits, &result)) {
+	chess_game_perform_move(&game, result.best);
+      }
+    }
   }
 
   frame_close(&frame);